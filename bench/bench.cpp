@@ -0,0 +1,142 @@
+#include "trajectory.h"
+#include <argparse/argparse.hpp>
+#include <iomanip>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+// elements of the synthetic trajectories
+std::vector<std::string> elements = { "C", "C", "C", "H", "H", "H", "H", "N", "O" };
+
+struct Result {
+    std::string name; std::vector<double> times; size_t bytes = 0;
+};
+
+std::string generate(const std::filesystem::path& path, int atoms, int frames) {
+    std::mt19937 generator(42); std::uniform_real_distribution<float> noise(-0.1f, 0.1f);
+    std::ofstream file(path); int side = (int)std::ceil(std::cbrt(atoms));
+
+    // atoms on a jittered cubic lattice with the bond length spacing, vibrating around their sites
+    std::vector<glm::vec3> sites(atoms); std::vector<std::string> symbols(atoms);
+    for (int i = 0; i < atoms; i++) {
+        sites.at(i) = 1.4f * glm::vec3(i % side, i / side % side, i / side / side) + glm::vec3(noise(generator), noise(generator), noise(generator));
+        symbols.at(i) = elements.at(generator() % elements.size());
+    }
+    for (int i = 0; i < frames; i++) {
+        file << atoms << "\nframe " << i << "\n";
+        for (int j = 0; j < atoms; j++) {
+            glm::vec3 position = sites.at(j) + glm::vec3(noise(generator), noise(generator), noise(generator));
+            file << symbols.at(j) << " " << position.x << " " << position.y << " " << position.z << "\n";
+        }
+    }
+    return path.string();
+}
+
+int main(int argc, char** argv) {
+    // initialize the argument parser and container for the arguments
+    argparse::ArgumentParser program("Luis Bench", "1.0", argparse::default_arguments::none);
+
+    // add options to the parser
+    program.add_argument("-a").help("Number of atoms in the synthetic trajectory.").default_value(1000).scan<'i', int>();
+    program.add_argument("-f").help("Number of frames in the synthetic trajectory.").default_value(100).scan<'i', int>();
+    program.add_argument("-h").help("Display this help message and exit.").default_value(false).implicit_value(true);
+    program.add_argument("-o").help("Output JSON file, the results are printed if empty.").default_value(std::string(""));
+    program.add_argument("-r").help("Number of repetitions of every benchmark.").default_value(5).scan<'i', int>();
+
+    // extract the variables from the command line
+    try {
+        program.parse_args(argc, argv);
+    } catch (const std::runtime_error &error) {
+        std::cerr << error.what() << std::endl << std::endl << program; return EXIT_FAILURE;
+    }
+
+    // print help if the help flag was provided
+    if (program.get<bool>("-h")) {
+        std::cout << program.help().str(); return EXIT_SUCCESS;
+    }
+
+    // every benchmark needs a time to report its minimum
+    if (program.get<int>("-r") < 1) {
+        std::cerr << "The number of repetitions must be positive." << std::endl << std::endl << program; return EXIT_FAILURE;
+    }
+
+    // generate the trajectory and define the results and the function that times the benchmarks
+    int atoms = program.get<int>("-a"), frames = program.get<int>("-f"), repeats = program.get<int>("-r");
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string input = generate(directory / "luis_bench.xyz", atoms, frames), output = (directory / "luis_bench_save.xyz").string();
+    std::vector<Result> results; size_t bytes = std::filesystem::file_size(input);
+    auto measure = [&](const std::string& name, const std::function<void()>& function, size_t bytes = 0, const std::function<void()>& prepare = {}) {
+        Result result = { name, {}, bytes };
+        for (int i = 0; i < repeats; i++) {
+            if (prepare) prepare();
+            auto start = std::chrono::high_resolution_clock().now(); function();
+            result.times.push_back(std::chrono::duration<double>(std::chrono::high_resolution_clock().now() - start).count());
+        }
+        results.push_back(result), std::cerr << name << ": " << *std::min_element(result.times.begin(), result.times.end()) << " s" << std::endl;
+    };
+
+    // loading of the text file, the previous trajectory is destroyed first to stop its sidecar writer
+    Trajectory trajectory;
+    measure("Trajectory::Load text", [&]() { trajectory = Trajectory::Load(input); }, bytes, [&]() { trajectory = Trajectory(), std::filesystem::remove(input + Sidecar::extension); });
+
+    // writing of the sidecar from the decoded frames, the throughput counts the written bytes
+    std::shared_ptr<Reader> reader = Reader::Open(input); std::vector<std::shared_ptr<const Geometry>> decoded; trajectory = Trajectory();
+    for (size_t i = 0; i < reader->size(); i++) decoded.push_back(std::make_shared<const Geometry>(reader->getGeom(i, i ? decoded.at(0)->getTopology() : nullptr, BINDINGFACTOR)));
+    measure("Sidecar::Write", [&]() { Sidecar::Write(input, decoded.size(), [&decoded](size_t i) { return decoded.at(i); }); });
+    results.back().bytes = std::filesystem::file_size(input + Sidecar::extension);
+
+    // loading of the sidecar
+    measure("Trajectory::Load sidecar", [&]() { trajectory = Trajectory::Load(input); }, std::filesystem::file_size(input + Sidecar::extension));
+
+    // parsing and bonding of the first frame, it spans the count, comment and atom lines
+    std::string text, line; std::ifstream file(input);
+    for (int i = 0; i < atoms + 2 && std::getline(file, line); i++) text += line + "\n";
+    Geometry geom = Geometry::Load(text);
+    measure("Geometry::Load", [&]() { geom = Geometry::Load(text); }, text.size());
+    measure("Geometry::rebind", [&]() { geom.rebind(BINDINGFACTOR); });
+
+    // trajectory wide changes
+    measure("Trajectory::setAtomSizeFactor", [&]() { trajectory.setAtomSizeFactor(ATOMSIZEFACTOR); });
+    measure("Trajectory::setBondSize", [&]() { trajectory.setBondSize(BONDSIZE); });
+    measure("Trajectory::rebind", [&]() { trajectory.rebind(BINDINGFACTOR), trajectory.finish(); });
+    measure("Trajectory::save", [&]() { trajectory.save(output), trajectory.finish(); });
+    results.back().bytes = std::filesystem::file_size(output);
+
+    // compression of the positions into the store and their decoding in playback order
+    std::shared_ptr<FrameStore> store; auto read = [&trajectory](size_t i) { return *trajectory.getGeom(i); };
+    measure("FrameStore::encode", [&]() {
+        store = std::make_shared<FrameStore>(frames, trajectory.getGeom().getTopology(), 0.001f);
+        for (size_t i = 0; i * STOREKEYFRAME < (size_t)frames; i++) store->encode(i, read);
+    }, sizeof(glm::vec3) * atoms * frames);
+    measure("FrameStore::getGeom", [&]() { for (int i = 0; i < frames; i++) geom = store->getGeom(i); }, sizeof(glm::vec3) * atoms * frames);
+
+    // the meshes need a context, it is created without a display
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    if (glfwInit()) {
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE), glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4), glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API), glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        GLFWwindow* window = glfwCreateWindow(1, 1, "Luis Bench", nullptr, nullptr);
+        if (!window) glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API), window = glfwCreateWindow(1, 1, "Luis Bench", nullptr, nullptr);
+        if (window && (glfwMakeContextCurrent(window), gladLoadGL(glfwGetProcAddress))) {
+            for (int i = 0; i <= 6; i++) measure("Mesh::Icosphere " + std::to_string(i), [i]() { Mesh::Icosphere(i, SMOOTH); });
+            for (int i = 4; i <= 128; i *= 2) measure("Mesh::Cylinder " + std::to_string(i), [i]() { Mesh::Cylinder(i, SMOOTH); });
+        } else std::cerr << "Skipping the mesh benchmarks without an OpenGL context." << std::endl;
+        glfwTerminate();
+    }
+
+    // print the results in JSON
+    std::ostringstream json; json << std::setprecision(9) << "{\n  \"atoms\": " << atoms << ",\n  \"frames\": " << frames << ",\n  \"repeats\": " << repeats << ",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results.at(i); double best = *std::min_element(result.times.begin(), result.times.end());
+        double mean = std::accumulate(result.times.begin(), result.times.end(), 0.0) / result.times.size();
+        json << (i ? "," : "") << "\n    { \"name\": \"" << result.name << "\", \"best\": " << best << ", \"mean\": " << mean;
+        if (result.bytes) json << ", \"bytes\": " << result.bytes << ", \"throughput\": " << result.bytes / 1e6 / best;
+        json << " }";
+    }
+    json << "\n  ]\n}\n";
+
+    // write or print the results and remove the generated files
+    if (program.get<std::string>("-o").empty()) std::cout << json.str();
+    else std::ofstream(program.get<std::string>("-o")) << json.str();
+    for (const std::string& path : { input, input + Sidecar::extension, output }) std::filesystem::remove(path);
+}
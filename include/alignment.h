@@ -0,0 +1,19 @@
+#pragma once
+
+#include "geometry.h"
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#define ALIGNITERATIONS 4
+
+class Alignment {
+public:
+    struct Options {
+        int reference = 0; bool average = false; std::vector<size_t> atoms;
+    };
+
+    // Static functions
+    static std::vector<glm::mat4> Run(size_t frames, std::function<std::shared_ptr<const Geometry>(size_t)> frame, const Options& options);
+    static glm::mat4 Kabsch(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& reference);
+};
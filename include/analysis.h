@@ -0,0 +1,34 @@
+#pragma once
+
+#include "geometry.h"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#define ANALYSISBLOCK 1024
+
+class Analysis {
+public:
+    // the error is written before the failed flag is set, so it can be read once the flag is seen
+    struct Series {
+        std::vector<size_t> atoms; std::vector<float> values; std::atomic<size_t> done = 0;
+        std::string error; std::atomic<bool> failed = false;
+        bool isReady() const { return done == values.size(); }
+    };
+
+    // Constructors and destructors
+    Analysis(size_t frames, std::function<std::shared_ptr<const Geometry>(size_t)> frame) : frame(frame), frames(frames) {}; ~Analysis();
+
+    // Getters
+    std::shared_ptr<const Series> get(const std::vector<size_t>& atoms);
+
+private:
+    void compute(Series& series, std::stop_token stop) const;
+
+    std::function<std::shared_ptr<const Geometry>(size_t)> frame;
+    std::map<std::vector<size_t>, std::shared_ptr<Series>> cache;
+    std::vector<std::jthread> threads;
+    size_t frames;
+};
@@ -8,26 +8,34 @@ struct Vertex {
     glm::vec3 position, normal = glm::vec3(0), color = glm::vec3(1);
 };
 
+struct Instance {
+    glm::mat4 model = glm::mat4(1), next = glm::mat4(1); glm::vec3 color = glm::vec3(1);
+};
+
 class Buffer {
 public:
 
     // Constructors and destructors
-    Buffer(const Buffer& buffer) : data(buffer.getData()) { generate(); };
-    Buffer(const std::vector<Vertex>& data) : data(data) { generate(); };
+    Buffer(const Buffer& buffer) : data(buffer.getData()), indices(buffer.getIndices()) { generate(); };
+    Buffer(const std::vector<Vertex>& data, const std::vector<unsigned int>& indices) : data(data), indices(indices) { generate(); };
     Buffer() : data(0) { generate(); }; ~Buffer();
 
     // Operators
     Buffer& operator=(const Buffer& buffer);
 
     // Getters
+    std::vector<unsigned int> getIndices() const { return indices; }
     std::vector<Vertex> getData() const { return data; }
-    size_t getSize() const { return data.size(); };
+    size_t getSize() const { return indices.size(); };
 
     // State functions
+    void upload(const std::vector<Instance>& instances) const;
+    void attach(unsigned int pairs = 0) const;
     void bind() const;
 
 private:
     std::vector<Vertex> data;
-    unsigned int vao, vbo;
+    std::vector<unsigned int> indices;
+    unsigned int vao, vbo, ebo, ibo;
     void generate();
 };
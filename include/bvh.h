@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#define BVHLEAF 4
+#define BVHREFITS 32
+
+class Bvh {
+public:
+
+    // Constructors
+    Bvh(const std::vector<glm::vec3>& positions, const std::vector<float>& radii); Bvh() {};
+
+    // Getters
+    size_t size() const { return atoms.size(); }
+
+    // Queries
+    int intersect(const glm::vec3& origin, const glm::vec3& direction) const;
+    std::vector<unsigned int> query(const glm::vec3& center, float radius) const;
+
+    // State functions
+    void refit(const std::vector<glm::vec3>& positions, const std::vector<float>& radii);
+
+private:
+    // the children of an inner node are stored next to each other starting at first, a leaf has the count of its atoms
+    struct Node {
+        glm::vec3 lower; unsigned int first; glm::vec3 upper; unsigned int count;
+    };
+
+    std::vector<glm::vec4> spheres;
+    std::vector<unsigned int> atoms;
+    std::vector<Node> nodes;
+};
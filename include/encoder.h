@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Encoder {
+    struct Image {
+        std::string path; std::vector<unsigned char> pixels; int width, height;
+    };
+
+public:
+
+    // Constructors and destructors
+    Encoder(size_t threads); ~Encoder();
+
+    // Static functions
+    static void Write(const std::string& path, std::vector<unsigned char> pixels, int width, int height);
+
+    // State functions
+    void push(const std::string& path, std::vector<unsigned char> pixels, int width, int height);
+    void wait();
+
+private:
+    std::condition_variable condition;
+    std::vector<std::thread> threads;
+    std::exception_ptr error;
+    std::deque<Image> queue;
+    size_t limit, busy = 0;
+    bool stop = false;
+    std::mutex mutex;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+class Framebuffer {
+public:
+
+    // Constructors and destructors
+    Framebuffer(int width, int height, int samples); ~Framebuffer();
+    Framebuffer(const Framebuffer&) = delete;
+
+    // Operators
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    // Getters
+    std::vector<unsigned char> read() const;
+
+    // State functions
+    void bind() const;
+
+private:
+    unsigned int fbo, color, depth, resolve, image;
+    int width, height;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "geometry.h"
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+
+class FrameCache {
+public:
+
+    // Constructors and destructors
+    FrameCache(std::function<Geometry(size_t)> decode, size_t frames, size_t budget); ~FrameCache();
+
+    // Getters
+    std::shared_ptr<const Geometry> get(size_t frame, bool wait = true);
+    std::shared_ptr<const Geometry> peek(size_t frame);
+
+    // State functions
+    void reset(std::function<Geometry(size_t)> decode);
+
+private:
+    void insert(size_t frame, const std::shared_ptr<const Geometry>& geom, size_t generation);
+    void prefetch();
+
+    std::unordered_map<size_t, std::pair<std::shared_ptr<const Geometry>, std::list<size_t>::iterator>> cache;
+    std::unordered_map<size_t, std::exception_ptr> failures;
+    std::function<Geometry(size_t)> decode;
+    size_t frames, budget, memory = 0, generation = 0, target = 0;
+    std::condition_variable condition;
+    std::list<size_t> order;
+    int direction = 1;
+    bool stop = false;
+    std::mutex mutex;
+    std::thread thread;
+};
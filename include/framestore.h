@@ -0,0 +1,39 @@
+#pragma once
+
+#include "geometry.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+#define STOREBLOCK 32
+#define STOREKEYFRAME 16
+#define STORERANGE 8388608
+
+class FrameStore {
+public:
+
+    // Constructors
+    FrameStore(size_t frames, const std::shared_ptr<Topology>& topology, float precision);
+
+    // Getters
+    Geometry getGeom(size_t frame) const;
+    float getPrecision() const { return precision; }
+    size_t getBytes() const { return bytes; }
+    size_t size() const { return records.size(); }
+
+    // State functions
+    bool encode(size_t group, const std::function<Geometry(size_t)>& decode);
+
+private:
+    static void Apply(const uint8_t* record, size_t blocks, float* state);
+
+    std::shared_ptr<Topology> topology;
+    std::vector<std::vector<uint8_t>> records;
+    std::vector<glm::mat3> cells;
+    std::atomic<size_t> bytes = 0;
+    size_t blocks, id;
+    float precision;
+};
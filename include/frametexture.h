@@ -0,0 +1,28 @@
+#pragma once
+
+#include "geometry.h"
+
+class FrameTexture {
+public:
+
+    // Constructors and destructors
+    FrameTexture(size_t budget); ~FrameTexture();
+    FrameTexture(const FrameTexture&) = delete;
+
+    // Operators
+    FrameTexture& operator=(const FrameTexture&) = delete;
+
+    // Getters
+    bool contains(size_t frame) const { return frame >= start && frame < end; }
+    size_t getMemory() const { return memory; }
+
+    // State functions
+    void load(const std::vector<Geometry>& geoms, size_t frame);
+    void render(size_t frame, const Shader& shader, const Shader& sshader, int highlight = -1, const glm::mat3& cell = glm::mat3(0), bool wrap = false) const;
+    void reset() { start = end = 0; }
+
+private:
+    unsigned int positions, elements, textures[2], atoms, bonds;
+    std::vector<size_t> offsets;
+    size_t budget, start = 0, end = 0, natoms = 0, memory = 0;
+};
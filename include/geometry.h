@@ -3,48 +3,58 @@
 #include "ptable.h"
 #include "glfwpointer.h"
 #include "mesh.h"
+#include "neighbor.h"
+#include "topology.h"
 #include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
-#include <sstream>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <string_view>
 #include <unordered_map>
 
 class Geometry {
-    struct Object {
-        glm::mat4 getModel(glm::mat4 s = glm::mat4(1)) const {
-            return translate * rotate * s * scale;
-        }
-        glm::vec3 getPosition() const {
-            return glm::vec3(translate[3]);
-        }
-        glm::mat4 translate, rotate, scale;
-        std::string name;
-    };
-
 public:
 
     // Constructors
+    Geometry(const std::shared_ptr<Topology>& topology, std::vector<glm::vec3> positions, std::vector<glm::uvec2> bonds) : topology(topology), positions(std::move(positions)), bonds(std::move(bonds)) {};
     Geometry() {};
 
     // Statc constructors
-    static Geometry Load(std::stringstream& file);
+    static Geometry Load(std::string_view frame, const std::shared_ptr<Topology>& hint = nullptr, float factor = BINDINGFACTOR);
+
+    // Static functions
+    static glm::mat4 Cylinder(const glm::vec3& a, const glm::vec3& b);
 
     // Getters
-    std::vector<Object>& getObjects();
+    const std::vector<glm::vec3>& getPositions() const { return positions; }
+    const std::vector<glm::uvec2>& getBonds() const { return bonds; }
+    const std::shared_ptr<Topology>& getTopology() const { return topology; }
+    const glm::mat3& getCell() const { return cell; }
+    const std::string& getSymbol(size_t atom) const { return topology->getSymbol(atom); }
+    std::vector<glm::uvec2> findBonds(float factor) const;
     glm::vec3 getCenter() const;
+    size_t getMemory() const;
     size_t size() const;
 
     // Setters
-    void setAtomSizeFactor(float factor);
-    void setBondSize(float size);
+    void setBonds(std::vector<glm::uvec2> bonds) { this->bonds = std::move(bonds); }
+    void setCell(const glm::mat3& cell) { this->cell = cell; }
 
     // State functions
     void moveBy(const glm::vec3& vector);
-    void render(const Shader& shader, const Shader& sshader, int highlight = -1) const;
+    void transformBy(const glm::mat4& matrix);
+    void render(const Shader& shader, const Shader& sshader, int highlight = -1, const Geometry* next = nullptr, const glm::mat4& transform = glm::mat4(1), bool wrap = false) const;
     void rebind(float factor);
 
     // Public static variables
     inline static std::unordered_map<std::string, Mesh> meshes;
+    inline static std::vector<Mesh> lods; inline static int lod = SUBDIVISIONS;
+    inline static struct View { glm::mat4 matrix; float scale; } view = { glm::mat4(1), 0 };
 
 private:
-    std::vector<Object> objects;
+    std::shared_ptr<Topology> topology;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::uvec2> bonds;
+    glm::mat3 cell = glm::mat3(0);
 };
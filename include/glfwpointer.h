@@ -1,27 +1,34 @@
 #pragma once
 
 #include "mesh.h"
+#include <functional>
 
 #define WIDTH 1024
 #define HEIGHT 576
 #define SUBDIVISIONS 2
+#define LODLEVELS 6
+#define LODERROR 0.5
 #define SECTORS 16
 #define SMOOTH 1
 #define BINDINGFACTOR 0.013
 #define BONDSIZE 0.09
 #define ATOMSIZEFACTOR 0.007
+#define MEMORY 4096
+#define PRECISION 0
+#define VIDEOMEMORY 512
 
 struct GLFWwindow;
 
 struct GLFWPointer {
-    std::string title = "Luis"; glm::vec2 mouse; GLFWwindow* window;
+    std::string title = "Luis"; glm::vec2 mouse, press; GLFWwindow* window;
     int width = WIDTH, height = HEIGHT, samples = 16, major = 4, minor = 2;
-    int highlight = -1;
+    int highlight = -1, picked = -1, memory = MEMORY; float precision = PRECISION;
+    std::function<int(const glm::vec3&, const glm::vec3&)> pick;
     struct Camera {
         glm::mat4 view, proj;
     } camera{};
     struct Flags {
-        bool fullscreen = false, info = false, options = false;
+        bool fullscreen = false, impostor = false, info = false, options = false;
         bool pause = false, system = false, ptable = false;
     } flags{};
     struct Light {
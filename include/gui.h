@@ -1,11 +1,13 @@
 #pragma once
 
+#include "encoder.h"
 #include "trajectory.h"
 #include <GLFW/glfw3.h>
 #include <ImGuiFileDialog.h>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_opengl3.h>
 #include <implot.h>
+#include <numeric>
 
 class Gui {
 public:
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+class MappedFile {
+public:
+
+    // Constructors and destructors
+    MappedFile(const std::string& filename); ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+
+    // Operators
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Getters
+    std::string_view view() const { return { pointer, length }; }
+    const char* data() const { return pointer; }
+    size_t size() const { return length; }
+
+private:
+    const char* pointer = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void *file = nullptr, *mapping = nullptr;
+#else
+    int descriptor = -1;
+#endif
+};
@@ -1,29 +1,33 @@
 #pragma once
 
 #include "buffer.h"
+#include "profiler.h"
 #include "shader.h"
 #include <algorithm>
+#include <unordered_map>
 
 class Mesh {
 public:
 
     // Constructors
-    Mesh(std::vector<Vertex> data, const std::string& name = "mesh") : name(name), model(1.0f), buffer(data) {};
+    Mesh(const std::vector<Vertex>& data, const std::vector<unsigned int>& indices, const std::string& name = "mesh") : name(name), model(1.0f), buffer(data, indices) {};
     Mesh() {};
 
     // Static constructors
+    static Mesh Cube(const std::string& name = "cube");
     static Mesh Cylinder(int sectors, bool smooth, const std::string& name = "cylinder");
     static Mesh Icosphere(int subdivisions, bool smooth, const std::string& name = "icosphere");
+    static Mesh Quad(const std::string& name = "quad");
 
     // Getters
-    std::string getName() const; glm::vec3 getPosition() const;
+    std::string getName() const; glm::vec3 getPosition() const; const glm::mat4& getModel() const { return model; }
 
     // Setters
-    void setColor(const glm::vec3& color);
     void setModel(const glm::mat4& model);
 
     // State functions
-    void render(const Shader& shader, const glm::mat4& transform = glm::mat4(1.0f)) const;
+    void render(const Shader& shader, const std::vector<Instance>& instances) const;
+    void render(const Shader& shader, unsigned int pairs, int count, int base = 0) const;
 
 private:
     std::string name;
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#define PARALLELTHRESHOLD 4096
+#define SKIN 0.4f
+
+class Neighbor {
+public:
+
+    // Candidate pairs reused between frames until an atom moves by more than half of the skin
+    class Verlet {
+    public:
+        std::vector<glm::uvec2> bonds(const std::vector<glm::vec3>& positions, const std::vector<float>& radii, float factor, const glm::mat3& cell = glm::mat3(0));
+
+    private:
+        std::vector<glm::uvec2> candidates;
+        std::vector<glm::vec3> reference;
+        std::vector<float> cutoffs, radii;
+        glm::mat3 cell = glm::mat3(0);
+        int age = 0, skip = 0;
+        float factor = 0;
+    };
+
+    // Static functions
+    static std::vector<glm::uvec2> Bonds(const std::vector<glm::vec3>& positions, const std::vector<float>& radii, float factor, float skin = 0, const glm::mat3& cell = glm::mat3(0));
+
+    // Periodic functions, the fraction is the inverse of the cell
+    static glm::vec3 Image(const glm::vec3& vector, const glm::mat3& cell, const glm::mat3& fraction) { glm::vec3 s = fraction * vector; return cell * (s - glm::round(s)); }
+    static glm::vec3 Wrap(const glm::vec3& position, const glm::mat3& cell, const glm::mat3& fraction) { return position - cell * glm::floor(fraction * position); }
+    static bool Periodic(const glm::mat3& cell) { return glm::determinant(cell) != 0; }
+};
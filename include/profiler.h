@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define HISTORY 256
+
+class Profiler {
+public:
+
+    // Timer of a named section that ends with the scope, when the next section starts or when ended explicitly
+    class Scope {
+    public:
+        Scope(const char* name) { next(name); }; ~Scope() { end(); }; Scope(const Scope&) = delete;
+        void next(const char* name); void end();
+
+    private:
+        std::chrono::steady_clock::time_point start;
+        const char* name = nullptr;
+    };
+
+    // Section of the frame breakdown with its duration in milliseconds over the last frames
+    struct Section {
+        std::string name; std::vector<float> history = std::vector<float>(HISTORY); float total = 0;
+    };
+
+    // Static functions
+    static const std::vector<Section>& Sections() { return sections; }
+    static void Start(const std::string& path);
+    static void Frame();
+    static void Stop();
+
+private:
+    static void Record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+
+    inline static std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    inline static std::atomic<std::thread::id> thread;
+    inline static std::vector<Section> sections;
+    inline static std::atomic<bool> tracing;
+    inline static std::string buffer;
+    inline static std::ofstream file;
+    inline static std::mutex mutex;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "geometry.h"
+#include "mappedfile.h"
+#include "writer.h"
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+
+#define XTCMAGIC 1995
+
+class Reader {
+public:
+    // a format is picked by its magic bytes first and by the extension of the path otherwise
+    struct Format {
+        std::vector<std::string> extensions; std::function<bool(std::string_view)> probe;
+        std::function<std::shared_ptr<Reader>(const std::string&)> open;
+    };
+
+    // Constructors and destructors
+    Reader(const std::string& path) : file(path) {}; virtual ~Reader() = default;
+
+    // Static constructors
+    static std::shared_ptr<Reader> Open(const std::string& path);
+
+    // Static functions
+    static std::shared_ptr<Topology> Companion(const std::string& path, size_t atoms);
+    static void Register(const Format& format);
+
+    // Getters
+    virtual Geometry getGeom(size_t frame, const std::shared_ptr<Topology>& hint, float factor) const = 0;
+    virtual bool isText() const { return false; }
+    size_t getBytes() const { return file.size(); }
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+protected:
+    template <typename T> static T Value(const char* data, bool swap);
+
+    std::shared_ptr<Topology> topology;
+    std::vector<size_t> offsets;
+    MappedFile file;
+
+private:
+    static std::vector<Format>& Formats();
+};
+
+class XyzReader : public Reader {
+public:
+
+    // Constructors
+    XyzReader(const std::string& path);
+
+    // Static functions
+    static std::vector<size_t> Index(std::string_view data);
+
+    // Getters
+    Geometry getGeom(size_t frame, const std::shared_ptr<Topology>& hint, float factor) const override;
+    bool isText() const override { return true; }
+};
+
+class XyzbReader : public Reader {
+public:
+
+    // Constructors
+    XyzbReader(const std::string& path);
+
+    // Getters
+    Geometry getGeom(size_t frame, const std::shared_ptr<Topology>& hint, float factor) const override;
+};
+
+class XtcReader : public Reader {
+    // the state of the big endian bit stream of the compressed coordinates
+    struct Bits {
+        const unsigned char* data; size_t size, count = 0; unsigned int lastbits = 0, lastbyte = 0;
+        unsigned int receive(int bits);
+        void receive(int bits, const unsigned int sizes[3], int numbers[3]);
+    };
+
+public:
+
+    // Constructors
+    XtcReader(const std::string& path);
+
+    // Getters
+    Geometry getGeom(size_t frame, const std::shared_ptr<Topology>& hint, float factor) const override;
+
+private:
+    static int Bitsize(const unsigned int sizes[3]);
+    size_t atoms = 0;
+};
+
+class DcdReader : public Reader {
+public:
+
+    // Constructors
+    DcdReader(const std::string& path);
+
+    // Getters
+    Geometry getGeom(size_t frame, const std::shared_ptr<Topology>& hint, float factor) const override;
+
+private:
+    size_t atoms = 0; bool swap = false, unitcell = false;
+};
+
+/*
+Returns the value stored at the pointer, with its bytes reversed if the byte order of the file differs from the machine.
+*/
+template <typename T>
+T Reader::Value(const char* data, bool swap) {
+    char bytes[sizeof(T)]; T value;
+    if (swap) std::reverse_copy(data, data + sizeof(T), bytes);
+    else std::copy(data, data + sizeof(T), bytes);
+    return std::memcpy(&value, bytes, sizeof(T)), value;
+}
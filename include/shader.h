@@ -3,6 +3,7 @@
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 #include <stdexcept>
+#include <unordered_map>
 #include <vector>
 
 class Shader {
@@ -19,5 +20,7 @@ public:
 
 private:
     void errorCheck(unsigned int shader, const std::string& title) const;
+    int locate(const std::string& name) const;
+    std::unordered_map<std::string, int> uniforms;
     unsigned int id;
 };
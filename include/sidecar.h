@@ -0,0 +1,46 @@
+#pragma once
+
+#include "geometry.h"
+#include "mappedfile.h"
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <stop_token>
+
+class Sidecar {
+    struct Header {
+        char magic[4]; uint32_t version; uint64_t size; int64_t time;
+        uint64_t frames, atoms, symbols, index; float factor;
+    };
+
+public:
+
+    // Constructors
+    Sidecar(const std::string& path) : file(path) {};
+
+    // Static constructors
+    static std::shared_ptr<Sidecar> Open(const std::string& source);
+
+    // Static functions
+    static void Write(const std::string& source, size_t frames, const std::function<std::shared_ptr<const Geometry>(size_t)>& frame, std::stop_token stop = {});
+
+    // Getters
+    const std::shared_ptr<Topology>& getTopology() const { return topology; }
+    float getFactor() const { return header->factor; }
+    size_t getBytes() const { return file.size(); }
+    size_t size() const { return header->frames; }
+    Geometry getGeom(size_t frame) const;
+
+    // Public static variables
+    inline static const std::string extension = ".luis";
+    inline static const uint32_t version = 2;
+
+private:
+    static Header Stamp(const std::string& source);
+
+    std::shared_ptr<Topology> topology;
+    const uint64_t* index = nullptr;
+    const Header* header = nullptr;
+    MappedFile file;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "glfwpointer.h"
+#include "ptable.h"
+#include <string_view>
+#include <vector>
+
+struct Topology {
+
+    // Getters
+    const std::string& getSymbol(size_t atom) const { return symbols.at(ids.at(atom)); }
+    size_t size() const { return ids.size(); }
+
+    // State functions
+    unsigned short add(std::string_view symbol);
+
+    // Per-element and per-atom data
+    std::vector<std::string> symbols;
+    std::vector<unsigned short> ids;
+    std::vector<float> radii;
+};
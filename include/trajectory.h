@@ -1,34 +1,111 @@
 #pragma once
 
-#include "geometry.h"
+#include "alignment.h"
+#include "analysis.h"
+#include "bvh.h"
+#include "framecache.h"
+#include "framestore.h"
+#include "frametexture.h"
+#include "reader.h"
+#include "sidecar.h"
+#include "writer.h"
+#include <atomic>
 #include <chrono>
-#include <fstream>
-#include <sstream>
+#include <cmath>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#define REBINDBLOCK 16
 
 class Trajectory {
 public:
     
-    // Constructors
-    Trajectory() {}
+    // Constructors and destructors
+    Trajectory() {}; ~Trajectory();
+    Trajectory(Trajectory&&) = default; Trajectory& operator=(Trajectory&&) = default;
 
     // Static constructors
-    static Trajectory Load(const std::string& movie);
+    static Trajectory Load(const std::string& movie, size_t memory = (size_t)MEMORY << 20, float precision = PRECISION);
 
     // Getters
-    std::vector<Geometry>& getGeoms() { return geoms; }
+    std::unique_ptr<Writer>& getExporter() { return exporter; }
+    std::string& getError() { return error; }
+    std::shared_ptr<const Geometry> getGeom(int frame);
+    const Geometry& getGeom() const { return *current; }
+    const glm::mat4& getTransform() const { return transform; }
+    bool isStreamed() const { return cache != nullptr; }
+    bool& getInterpolate() { return interpolate; }
+    bool& getOutline() { return outline; }
+    bool& getWrap() { return wrap; }
+    bool& getResident() { return resident; }
     bool& getPause() { return paused; }
+    float& getSpeed() { return speed; }
     int& getFrame() { return frame; }
     float& getWait() { return wait; }
-    int size() const { return geoms.size(); }
+    double getThroughput() const { return throughput; }
+    double getCompression() const { return compression; }
+    float getProgress() const { return job ? (float)job->done / job->total : 1; }
+    int size() const { return frames; }
+
+    // Setters
+    void setAtomSizeFactor(float factor);
+    void setBondSize(float size);
+    void setCell(const glm::mat3& cell);
 
     // State functions
+    void align(const Alignment::Options& options);
+    std::shared_ptr<const Analysis::Series> analyze(const std::vector<size_t>& atoms);
+    std::vector<unsigned int> query(const glm::vec3& center, float radius);
+    int pick(const glm::vec3& origin, const glm::vec3& direction);
+    void center();
     void moveBy(const glm::vec3& vector);
+    void transformBy(const glm::mat4& matrix);
     void render(const Shader& shader, const Shader& sshader, int highlight);
+    void render(const Geometry& geom, const Shader& shader, const Shader& sshader, int highlight = -1, const Geometry* next = nullptr, float alpha = 0) const;
+    void save(const std::string& filename, const Writer::Selection& selection = {});
+    void rebind(float factor);
+    void finish();
 
 private:
+    struct Job {
+        std::vector<std::pair<size_t, std::vector<glm::uvec2>>> results;
+        std::atomic<size_t> done = 0; size_t total = 0;
+        std::mutex mutex;
+    };
+
+    static std::shared_ptr<const FrameStore> Compress(size_t frames, const std::shared_ptr<Topology>& topology, float precision, size_t budget, const std::function<Geometry(size_t)>& decode);
+    std::function<std::shared_ptr<const Geometry>(size_t)> reader() const;
+    std::function<Geometry(size_t)> decoder(bool bonds = true) const;
+    const Bvh& index();
+    void renderCell(const Geometry& geom, const Shader& shader) const;
+    void setup(const Shader& shader, const Shader& sshader, float alpha) const;
+    void collect();
+
+    // the rebinding worker, the exporter, the analysis and the sidecar writer read the frames, so they are declared first to be
+    // stopped before the frames are replaced by a move
+    std::unique_ptr<Analysis> analysis;
+    std::unique_ptr<Writer> exporter;
+    std::jthread worker, writer;
+    std::shared_ptr<Job> job;
+
     std::chrono::high_resolution_clock::time_point timestamp;
+    std::shared_ptr<const std::vector<glm::mat4>> alignments;
+    std::optional<glm::mat3> cell;
+    std::shared_ptr<const Geometry> current, indexed;
+    std::shared_ptr<const FrameStore> store;
+    std::shared_ptr<Sidecar> sidecar;
+    std::shared_ptr<Reader> source;
+    std::shared_ptr<Topology> topology;
+    std::unique_ptr<FrameTexture> texture;
+    std::unique_ptr<FrameCache> cache;
     std::vector<Geometry> geoms;
-    bool paused = false;
-    float wait = 15.997;
-    int frame = 0;
+    Bvh bvh;
+    float factor = BINDINGFACTOR, atomSizeFactor = ATOMSIZEFACTOR, bondSize = BONDSIZE, indexedSize = 0;
+    glm::mat4 transform = glm::mat4(1);
+    bool paused = false, interpolate = true, resident = false, outline = true, wrap = false, indexedWrap = false;
+    double throughput = 0, cursor = 0, compression = 0;
+    std::string error;
+    float wait = 15.997, speed = 1;
+    int frame = 0, frames = 0, refits = 0;
 };
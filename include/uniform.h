@@ -0,0 +1,18 @@
+#pragma once
+
+#include <glad/gl.h>
+
+template <typename T>
+class Uniform {
+public:
+
+    // Constructors and destructors, the block is attached to the given binding point for its lifetime
+    Uniform(unsigned int binding) { glGenBuffers(1, &ubo), glBindBuffer(GL_UNIFORM_BUFFER, ubo), glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW), glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo); }
+    ~Uniform() { glDeleteBuffers(1, &ubo); }; Uniform(const Uniform&) = delete;
+
+    // State functions
+    void upload(const T& value) const { glBindBuffer(GL_UNIFORM_BUFFER, ubo), glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &value); }
+
+private:
+    unsigned int ubo;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "geometry.h"
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+class Writer {
+    struct Header {
+        char magic[4]; uint32_t version; uint64_t frames, atoms, symbols;
+    };
+
+public:
+    struct Selection {
+        int start = 0, end = INT_MAX, stride = 1; std::vector<size_t> atoms;
+    };
+
+    // Constructors and destructors
+    Writer(const std::string& path, size_t frames, std::function<std::shared_ptr<const Geometry>(size_t)> frame, const glm::mat4& transform, const Selection& selection);
+    ~Writer();
+
+    // Static functions
+    static Selection Parse(std::string frames, std::string atoms);
+
+    // Getters
+    float getProgress() const { return indices.empty() ? 1 : (float)written / indices.size(); }
+    size_t size() const { return indices.size(); }
+    bool isDone() const { return done; }
+
+    // State functions
+    void cancel() { thread.request_stop(); }
+    void wait();
+
+    // Public static variables
+    inline static const std::string extension = ".xyzb";
+    inline static const uint32_t version = 1;
+
+private:
+    std::string format(const Geometry& geom) const;
+    void run(std::stop_token stop);
+
+    std::function<std::shared_ptr<const Geometry>(size_t)> frame;
+    std::vector<size_t> indices, atoms;
+    std::atomic<size_t> written = 0;
+    std::atomic<bool> done = false;
+    std::exception_ptr error;
+    glm::mat4 transform;
+    std::string path;
+    bool binary;
+    std::jthread thread;
+};
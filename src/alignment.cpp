@@ -0,0 +1,116 @@
+#include "alignment.h"
+
+/*
+Returns the matrices that superimpose the selected atoms of every frame onto the reference frame, or onto the average
+structure of the aligned frames. The average is refined iteratively, starting from the reference frame. The frames are
+aligned on all threads, an empty atom selection uses all atoms.
+*/
+std::vector<glm::mat4> Alignment::Run(size_t frames, std::function<std::shared_ptr<const Geometry>(size_t)> frame, const Options& options) {
+    if (options.reference < 0 || options.reference >= (int)frames) throw std::runtime_error("Invalid reference frame " + std::to_string(options.reference + 1) + ".");
+    std::vector<glm::mat4> matrices(frames, glm::mat4(1)); Profiler::Scope scope("Align");
+
+    // function that returns the positions of the selected atoms
+    auto gather = [&options](const Geometry& geom) {
+        std::vector<glm::vec3> positions(options.atoms.empty() ? geom.size() : options.atoms.size());
+        for (size_t i = 0; i < positions.size(); i++) {
+            size_t atom = options.atoms.empty() ? i : options.atoms.at(i);
+            if (atom >= geom.size()) throw std::runtime_error("Atom " + std::to_string(atom + 1) + " is not in the frame.");
+            positions.at(i) = geom.getPositions().at(atom);
+        }
+        return positions;
+    };
+
+    // gather the reference positions
+    std::vector<glm::vec3> reference = gather(*frame(options.reference));
+    if (reference.size() < 3) throw std::runtime_error("The alignment needs at least three atoms.");
+
+    // align the frames and sum the aligned positions for the average structure
+    for (int iteration = 0; iteration < (options.average ? ALIGNITERATIONS : 1); iteration++) {
+        size_t nthread = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), frames);
+        std::vector<std::vector<double>> sums(nthread, std::vector<double>(options.average ? 3 * reference.size() : 0));
+        std::atomic<size_t> next = 0; std::atomic<bool> failed = false; std::exception_ptr error;
+        std::vector<std::thread> threads; std::mutex mutex;
+        for (size_t i = 0; i < nthread; i++) threads.emplace_back([&, i]() {
+            try {
+                for (size_t j = next++; j < frames && !failed; j = next++) {
+                    std::vector<glm::vec3> positions = gather(*frame(j));
+                    if (positions.size() != reference.size()) throw std::runtime_error("The alignment needs frames with the same atoms.");
+                    matrices.at(j) = Kabsch(positions, reference);
+                    for (size_t k = 0; k < sums.at(i).size() / 3; k++) {
+                        glm::vec3 position(matrices.at(j) * glm::vec4(positions.at(k), 1));
+                        sums.at(i).at(3 * k) += position.x, sums.at(i).at(3 * k + 1) += position.y, sums.at(i).at(3 * k + 2) += position.z;
+                    }
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex); error = std::current_exception(), failed = true;
+            }
+        });
+        for (std::thread& thread : threads) thread.join();
+        if (error) std::rethrow_exception(error);
+
+        // average the aligned positions
+        for (size_t k = 0; options.average && k < reference.size(); k++) {
+            glm::dvec3 sum(0); for (const std::vector<double>& partial : sums) sum += glm::dvec3(partial.at(3 * k), partial.at(3 * k + 1), partial.at(3 * k + 2));
+            reference.at(k) = glm::vec3(sum / (double)frames);
+        }
+    }
+
+    // return the matrices
+    return matrices;
+}
+
+/*
+Returns the rigid transform that superimposes the positions onto the reference with the least squared deviation. The
+optimal rotation of the Kabsch problem is found as the unit quaternion of the largest eigenvalue of the symmetric 4x4
+matrix built from the covariance of the centered positions, so no reflection has to be corrected and the eigenvector is
+found by Jacobi rotations.
+*/
+glm::mat4 Alignment::Kabsch(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& reference) {
+    glm::dvec3 center(0), target(0); double S[3][3] = {}, N[4][4], V[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+
+    // find the centers and the covariance of the centered positions
+    for (size_t i = 0; i < positions.size(); i++) center += glm::dvec3(positions.at(i)) / (double)positions.size(), target += glm::dvec3(reference.at(i)) / (double)positions.size();
+    for (size_t i = 0; i < positions.size(); i++) {
+        glm::dvec3 p = glm::dvec3(positions.at(i)) - center, q = glm::dvec3(reference.at(i)) - target;
+        for (int a = 0; a < 3; a++) for (int b = 0; b < 3; b++) S[a][b] += p[a] * q[b];
+    }
+
+    // build the symmetric matrix of the quaternion
+    N[0][0] = S[0][0] + S[1][1] + S[2][2], N[0][1] = S[1][2] - S[2][1], N[0][2] = S[2][0] - S[0][2], N[0][3] = S[0][1] - S[1][0];
+    N[1][1] = S[0][0] - S[1][1] - S[2][2], N[1][2] = S[0][1] + S[1][0], N[1][3] = S[2][0] + S[0][2];
+    N[2][2] = S[1][1] - S[0][0] - S[2][2], N[2][3] = S[1][2] + S[2][1];
+    N[3][3] = S[2][2] - S[0][0] - S[1][1];
+    for (int a = 0; a < 4; a++) for (int b = 0; b < a; b++) N[a][b] = N[b][a];
+
+    // diagonalize the matrix by the Jacobi rotations, the columns of V are the eigenvectors
+    for (int sweep = 0; sweep < 32; sweep++) {
+        double off = 0; for (int a = 0; a < 4; a++) for (int b = a + 1; b < 4; b++) off += std::abs(N[a][b]);
+        if (off < 1e-12 * (std::abs(N[0][0]) + std::abs(N[1][1]) + std::abs(N[2][2]) + std::abs(N[3][3]) + 1e-30)) break;
+        for (int p = 0; p < 4; p++) for (int q = p + 1; q < 4; q++) if (N[p][q] != 0) {
+            double theta = (N[q][q] - N[p][p]) / (2 * N[p][q]), t = (theta < 0 ? -1 : 1) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+            double c = 1 / std::sqrt(t * t + 1), s = t * c;
+            for (int k = 0; k < 4; k++) {
+                double kp = N[k][p], kq = N[k][q]; N[k][p] = c * kp - s * kq, N[k][q] = s * kp + c * kq;
+            }
+            for (int k = 0; k < 4; k++) {
+                double pk = N[p][k], qk = N[q][k]; N[p][k] = c * pk - s * qk, N[q][k] = s * pk + c * qk;
+            }
+            for (int k = 0; k < 4; k++) {
+                double kp = V[k][p], kq = V[k][q]; V[k][p] = c * kp - s * kq, V[k][q] = s * kp + c * kq;
+            }
+        }
+    }
+
+    // take the quaternion of the largest eigenvalue and build the rotation
+    int largest = 0; for (int a = 1; a < 4; a++) if (N[a][a] > N[largest][largest]) largest = a;
+    double w = V[0][largest], x = V[1][largest], y = V[2][largest], z = V[3][largest];
+    glm::mat4 rotation(
+        glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + w * z), 2 * (x * z - w * y), 0),
+        glm::vec4(2 * (x * y - w * z), 1 - 2 * (x * x + z * z), 2 * (y * z + w * x), 0),
+        glm::vec4(2 * (x * z + w * y), 2 * (y * z - w * x), 1 - 2 * (x * x + y * y), 0),
+        glm::vec4(0, 0, 0, 1)
+    );
+
+    // return the transform that moves the center to the origin, rotates and moves it to the reference center
+    return glm::translate(glm::mat4(1), glm::vec3(target)) * rotation * glm::translate(glm::mat4(1), -glm::vec3(center));
+}
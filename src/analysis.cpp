@@ -0,0 +1,78 @@
+#include "analysis.h"
+
+Analysis::~Analysis() {
+    for (std::jthread& thread : threads) thread.request_stop(), thread.join();
+}
+
+/*
+Returns the series of the atom tuple, two atoms give the distance, three the angle at the middle atom and four the dihedral
+angle in degrees. A series that is not cached is computed in the background, it can be plotted once it is ready.
+*/
+std::shared_ptr<const Analysis::Series> Analysis::get(const std::vector<size_t>& atoms) {
+    if (atoms.size() < 2 || atoms.size() > 4) throw std::runtime_error("The analysis needs two to four atoms.");
+    if (auto it = cache.find(atoms); it != cache.end()) return it->second;
+
+    // create the series and compute it on a background thread
+    std::shared_ptr<Series> series = std::make_shared<Series>(); series->atoms = atoms, series->values.resize(frames);
+    threads.emplace_back([this, series](std::stop_token stop) { compute(*series, stop); });
+    return cache[atoms] = series;
+}
+
+/*
+Compute the series in blocks of frames on all threads. The positions of the atoms in a block are gathered into separate
+coordinate arrays first, so the kernels are flat loops over the frames the compiler can vectorize. Frames without the
+atoms give NaN. A frame that fails to decode stops the computation and its error is stored in the series.
+*/
+void Analysis::compute(Series& series, std::stop_token stop) const {
+    size_t nthread = std::max(1u, std::thread::hardware_concurrency()), count = series.atoms.size(); std::atomic<size_t> next = 0;
+    std::vector<std::thread> workers; std::atomic<bool> failed = false; std::exception_ptr error; std::mutex mutex; Profiler::Scope scope("Analysis");
+
+    // compute the blocks of frames
+    for (size_t i = 0; i < nthread; i++) workers.emplace_back([&]() {
+        try {
+            std::vector<float> x[4], y[4], z[4]; for (size_t j = 0; j < count; j++) x[j].resize(ANALYSISBLOCK), y[j].resize(ANALYSISBLOCK), z[j].resize(ANALYSISBLOCK);
+            for (size_t start = next++ * ANALYSISBLOCK; start < frames && !stop.stop_requested() && !failed; start = next++ * ANALYSISBLOCK) {
+                size_t size = std::min<size_t>(ANALYSISBLOCK, frames - start); float* values = series.values.data() + start;
+
+                // gather the positions of the atoms, missing atoms are NaN
+                for (size_t f = 0; f < size; f++) {
+                    std::shared_ptr<const Geometry> geom = frame(start + f);
+                    for (size_t j = 0; j < count; j++) {
+                        glm::vec3 position = series.atoms.at(j) < geom->size() ? geom->getPositions().at(series.atoms.at(j)) : glm::vec3(NAN);
+                        x[j][f] = position.x, y[j][f] = position.y, z[j][f] = position.z;
+                    }
+                }
+
+                // distance between the two atoms
+                if (count == 2) for (size_t f = 0; f < size; f++) {
+                    float dx = x[1][f] - x[0][f], dy = y[1][f] - y[0][f], dz = z[1][f] - z[0][f];
+                    values[f] = std::sqrt(dx * dx + dy * dy + dz * dz);
+                }
+
+                // angle between the bonds to the middle atom
+                if (count == 3) for (size_t f = 0; f < size; f++) {
+                    float ax = x[0][f] - x[1][f], ay = y[0][f] - y[1][f], az = z[0][f] - z[1][f];
+                    float bx = x[2][f] - x[1][f], by = y[2][f] - y[1][f], bz = z[2][f] - z[1][f];
+                    float cosine = (ax * bx + ay * by + az * bz) / std::sqrt((ax * ax + ay * ay + az * az) * (bx * bx + by * by + bz * bz));
+                    values[f] = glm::degrees(std::acos(std::clamp(cosine, -1.0f, 1.0f)));
+                }
+
+                // dihedral angle between the planes of the first three and the last three atoms
+                if (count == 4) for (size_t f = 0; f < size; f++) {
+                    glm::vec3 b1(x[1][f] - x[0][f], y[1][f] - y[0][f], z[1][f] - z[0][f]), b2(x[2][f] - x[1][f], y[2][f] - y[1][f], z[2][f] - z[1][f]);
+                    glm::vec3 b3(x[3][f] - x[2][f], y[3][f] - y[2][f], z[3][f] - z[2][f]), n1 = glm::cross(b1, b2), n2 = glm::cross(b2, b3);
+                    values[f] = glm::degrees(std::atan2(glm::dot(glm::cross(n1, n2), b2) / glm::length(b2), glm::dot(n1, n2)));
+                }
+
+                // mark the block as done
+                series.done += size;
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex); error = std::current_exception(), failed = true;
+        }
+    });
+    for (std::thread& worker : workers) worker.join();
+
+    // store the error of the failed frame
+    try { if (error) std::rethrow_exception(error); } catch (const std::exception& exception) { series.error = exception.what(), series.failed = true; }
+}
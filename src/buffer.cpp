@@ -1,24 +1,54 @@
 #include "buffer.h"
 
 Buffer::~Buffer() {
-    glDeleteVertexArrays(1, &vao), glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao), glDeleteBuffers(1, &vbo), glDeleteBuffers(1, &ebo), glDeleteBuffers(1, &ibo);
 };
 
 Buffer& Buffer::operator=(const Buffer& buffer) {
-    glDeleteVertexArrays(1, &vao), glDeleteBuffers(1, &vbo);
-    this->data = buffer.data, generate();
+    glDeleteVertexArrays(1, &vao), glDeleteBuffers(1, &vbo), glDeleteBuffers(1, &ebo), glDeleteBuffers(1, &ibo);
+    this->data = buffer.data, this->indices = buffer.indices, generate();
     return *this;
 }
 
+/*
+Select the source of the per-instance attributes of the bound vertex array. The instance buffer of the mesh is used by
+default, otherwise only the atom index pairs are read from the provided buffer and the shader builds the model matrices.
+*/
+void Buffer::attach(unsigned int pairs) const {
+    for (int i = 3; i < 12; i++) pairs ? glDisableVertexAttribArray(i) : glEnableVertexAttribArray(i);
+    if (!pairs) return glDisableVertexAttribArray(12);
+    glBindBuffer(GL_ARRAY_BUFFER, pairs), glVertexAttribIPointer(12, 2, GL_UNSIGNED_INT, sizeof(glm::uvec2), nullptr);
+    glEnableVertexAttribArray(12), glVertexAttribDivisor(12, 1);
+}
+
 void Buffer::bind() const {
     glBindVertexArray(vao);
 }
 
 void Buffer::generate() {
-    glGenVertexArrays(1, &vao), glGenBuffers(1, &vbo), glBindBuffer(GL_ARRAY_BUFFER, vbo), glBindVertexArray(vao);
+    glGenVertexArrays(1, &vao), glGenBuffers(1, &vbo), glGenBuffers(1, &ebo), glGenBuffers(1, &ibo), glBindBuffer(GL_ARRAY_BUFFER, vbo), glBindVertexArray(vao);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
     glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
     glEnableVertexAttribArray(0), glEnableVertexAttribArray(1), glEnableVertexAttribArray(2);
     glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
+
+    // the element buffer binding is stored in the vertex array
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    // per-instance model matrix occupies four consecutive attribute locations followed by the color and the matrix of the next frame
+    glBindBuffer(GL_ARRAY_BUFFER, ibo);
+    for (int i = 0; i < 4; i++) {
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offsetof(Instance, model) + i * sizeof(glm::vec4)));
+        glVertexAttribPointer(8 + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offsetof(Instance, next) + i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(3 + i), glVertexAttribDivisor(3 + i, 1), glEnableVertexAttribArray(8 + i), glVertexAttribDivisor(8 + i, 1);
+    }
+    glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offsetof(Instance, color));
+    glEnableVertexAttribArray(7), glVertexAttribDivisor(7, 1);
+}
+
+void Buffer::upload(const std::vector<Instance>& instances) const {
+    glBindBuffer(GL_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STREAM_DRAW);
 }
@@ -0,0 +1,111 @@
+#include "bvh.h"
+
+/*
+Build the bounding volume hierarchy over the atom spheres. The atoms of a node are split at the median of the longest axis
+of their centers until at most BVHLEAF atoms remain, the children are created after their parent, so the bounds can be
+refitted in one backward pass.
+*/
+Bvh::Bvh(const std::vector<glm::vec3>& positions, const std::vector<float>& radii) : atoms(positions.size()) {
+    if (std::iota(atoms.begin(), atoms.end(), 0); atoms.empty()) return;
+    nodes.reserve(2 * atoms.size() / BVHLEAF + 1), nodes.push_back({ {}, 0, {}, (unsigned int)atoms.size() });
+
+    // split the nodes
+    for (std::vector<size_t> stack = { 0 }; !stack.empty();) {
+        size_t index = stack.back(); unsigned int first = nodes.at(index).first, count = nodes.at(index).count; stack.pop_back();
+        if (count <= BVHLEAF) continue;
+
+        // find the longest axis of the centers
+        glm::vec3 lower(INFINITY), upper(-INFINITY);
+        for (unsigned int i = first; i < first + count; i++) lower = glm::min(lower, positions.at(atoms.at(i))), upper = glm::max(upper, positions.at(atoms.at(i)));
+        glm::vec3 extent = upper - lower; int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+        // partition the atoms at the median and create the children
+        std::nth_element(atoms.begin() + first, atoms.begin() + first + count / 2, atoms.begin() + first + count, [&](unsigned int a, unsigned int b) {
+            return positions.at(a)[axis] < positions.at(b)[axis];
+        });
+        nodes.at(index).first = nodes.size(), nodes.at(index).count = 0;
+        nodes.push_back({ {}, first, {}, count / 2 }), nodes.push_back({ {}, first + count / 2, {}, count - count / 2 });
+        stack.push_back(nodes.size() - 2), stack.push_back(nodes.size() - 1);
+    }
+
+    // compute the bounds
+    refit(positions, radii);
+}
+
+/*
+Update the spheres and the bounds of the nodes for moved atoms or changed radii, the tree itself is kept. The atoms must be
+the ones the hierarchy was built for.
+*/
+void Bvh::refit(const std::vector<glm::vec3>& positions, const std::vector<float>& radii) {
+    spheres.resize(atoms.size());
+    for (size_t i = 0; i < atoms.size(); i++) spheres.at(i) = glm::vec4(positions.at(atoms.at(i)), radii.at(atoms.at(i)));
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node& node = nodes.at(i); node.lower = glm::vec3(INFINITY), node.upper = glm::vec3(-INFINITY);
+        if (node.count) for (unsigned int j = node.first; j < node.first + node.count; j++) {
+            node.lower = glm::min(node.lower, glm::vec3(spheres.at(j)) - spheres.at(j).w), node.upper = glm::max(node.upper, glm::vec3(spheres.at(j)) + spheres.at(j).w);
+        }
+        else for (unsigned int j = node.first; j < node.first + 2; j++) {
+            node.lower = glm::min(node.lower, nodes.at(j).lower), node.upper = glm::max(node.upper, nodes.at(j).upper);
+        }
+    }
+}
+
+/*
+Returns the atom whose sphere is hit first by the ray, or -1 if the ray misses all of them. The nearer child is visited
+first and nodes farther than the closest hit are skipped.
+*/
+int Bvh::intersect(const glm::vec3& origin, const glm::vec3& direction) const {
+    glm::vec3 unit = glm::normalize(direction), inverse = 1.0f / unit; float nearest = INFINITY; int hit = -1;
+    if (nodes.empty()) return hit;
+
+    // function that returns the distance where the ray enters the box, infinity if it misses it or enters behind the hit
+    auto enter = [&](const Node& node) {
+        glm::vec3 t1 = (node.lower - origin) * inverse, t2 = (node.upper - origin) * inverse, lower = glm::min(t1, t2), upper = glm::max(t1, t2);
+        float tmin = std::max({ lower.x, lower.y, lower.z, 0.0f }), tmax = std::min({ upper.x, upper.y, upper.z });
+        return tmin <= tmax && tmin < nearest ? tmin : INFINITY;
+    };
+
+    // traverse the nodes
+    unsigned int stack[64]; int top = 0; stack[top++] = 0;
+    while (top) {
+        const Node& node = nodes.at(stack[--top]);
+        if (enter(node) == INFINITY) continue;
+
+        // test the spheres of a leaf, a ray starting inside a sphere hits its far side
+        if (node.count) for (unsigned int i = node.first; i < node.first + node.count; i++) {
+            glm::vec3 offset = origin - glm::vec3(spheres.at(i)); float b = glm::dot(offset, unit), c = glm::dot(offset, offset) - spheres.at(i).w * spheres.at(i).w;
+            if (float discriminant = b * b - c; discriminant >= 0) {
+                float t = -b - std::sqrt(discriminant); if (t < 0) t = -b + std::sqrt(discriminant);
+                if (t >= 0 && t < nearest) nearest = t, hit = atoms.at(i);
+            }
+        }
+
+        // push the children with the nearer one on top
+        else {
+            unsigned int closer = node.first, farther = node.first + 1; float a = enter(nodes.at(closer)), b = enter(nodes.at(farther));
+            if (a > b) std::swap(closer, farther), std::swap(a, b);
+            if (b < INFINITY) stack[top++] = farther;
+            if (a < INFINITY) stack[top++] = closer;
+        }
+    }
+    return hit;
+}
+
+/*
+Returns the atoms with their centers within the radius of the point. Nodes whose bounds are farther than the radius are
+skipped.
+*/
+std::vector<unsigned int> Bvh::query(const glm::vec3& center, float radius) const {
+    std::vector<unsigned int> result, stack; if (!nodes.empty()) stack.push_back(0);
+    while (!stack.empty()) {
+        const Node& node = nodes.at(stack.back()); stack.pop_back();
+        glm::vec3 closest = glm::max(node.lower, glm::min(center, node.upper)) - center;
+        if (glm::dot(closest, closest) > radius * radius) continue;
+        if (node.count) for (unsigned int i = node.first; i < node.first + node.count; i++) {
+            glm::vec3 offset = glm::vec3(spheres.at(i)) - center;
+            if (glm::dot(offset, offset) <= radius * radius) result.push_back(atoms.at(i));
+        }
+        else stack.push_back(node.first), stack.push_back(node.first + 1);
+    }
+    return result;
+}
@@ -0,0 +1,73 @@
+#include "encoder.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+/*
+Start the worker threads that encode the queued images. The queue holds at most two images per thread.
+*/
+Encoder::Encoder(size_t threads) : limit(2 * threads) {
+    for (size_t i = 0; i < threads; i++) this->threads.emplace_back([this]() {
+        for (std::unique_lock<std::mutex> lock(mutex);;) {
+            condition.wait(lock, [this]() { return stop || !queue.empty(); });
+            if (queue.empty()) return;
+            Image image = std::move(queue.front()); queue.pop_front(), busy++, condition.notify_all(), lock.unlock();
+            try {
+                Write(image.path, std::move(image.pixels), image.width, image.height);
+            } catch (...) {
+                lock.lock(), error = std::current_exception(), busy--, condition.notify_all(); continue;
+            }
+            lock.lock(), busy--, condition.notify_all();
+        }
+    });
+}
+
+Encoder::~Encoder() {
+    {std::lock_guard<std::mutex> lock(mutex); stop = true;} condition.notify_all();
+    for (std::thread& thread : threads) thread.join();
+}
+
+/*
+Queue the image for encoding, waits while the queue is full.
+*/
+void Encoder::push(const std::string& path, std::vector<unsigned char> pixels, int width, int height) {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this]() { return queue.size() < limit || error; });
+    if (error) std::rethrow_exception(error);
+    queue.push_back({ path, std::move(pixels), width, height }), condition.notify_all();
+}
+
+/*
+Wait until all queued images are written and rethrow the first encoding error.
+*/
+void Encoder::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this]() { return (queue.empty() && !busy) || error; });
+    if (error) std::rethrow_exception(error);
+}
+
+/*
+Write the RGBA pixels with the bottom row first into an image, the format is chosen by the extension of the path. Throws if
+the image could not be written.
+*/
+void Encoder::Write(const std::string& path, std::vector<unsigned char> pixels, int width, int height) {
+    std::string extension = path.substr(path.find_last_of(".") + 1);
+
+    // flip the image
+    for (int i = 0; i < height / 2; i++) {
+        std::swap_ranges(pixels.begin() + 4 * i * width, pixels.begin() + 4 * (i + 1) * width, pixels.begin() + 4 * (height - i - 1) * width);
+    }
+
+    // save the buffer
+    int written;
+    if (extension == "png") {
+        written = stbi_write_png(path.c_str(), width, height, 4, pixels.data(), 4 * width);
+    } else if (extension == "jpg") {
+        written = stbi_write_jpg(path.c_str(), width, height, 4, pixels.data(), 80);
+    } else if (extension == "bmp") {
+        written = stbi_write_bmp(path.c_str(), width, height, 4, pixels.data());
+    } else {
+        throw std::runtime_error("Unknown file extension.");
+    }
+    if (!written) throw std::runtime_error("Could not write " + path + ".");
+}
@@ -0,0 +1,47 @@
+#include "framebuffer.h"
+
+/*
+Create the multisampled framebuffer with color, depth and stencil attachments and the single sampled one it resolves into.
+*/
+Framebuffer::Framebuffer(int width, int height, int samples) : width(width), height(height) {
+    int limit; glGetIntegerv(GL_MAX_SAMPLES, &limit); samples = std::min(samples, limit);
+
+    // multisampled framebuffer used for rendering
+    glGenFramebuffers(1, &fbo), glGenRenderbuffers(1, &color), glGenRenderbuffers(1, &depth), glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, color), glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth), glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Error during framebuffer creation.");
+    }
+
+    // single sampled framebuffer used for reading
+    glGenFramebuffers(1, &resolve), glGenRenderbuffers(1, &image), glBindFramebuffer(GL_FRAMEBUFFER, resolve);
+    glBindRenderbuffer(GL_RENDERBUFFER, image), glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, image);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Error during framebuffer creation.");
+    }
+}
+
+Framebuffer::~Framebuffer() {
+    glDeleteFramebuffers(1, &fbo), glDeleteFramebuffers(1, &resolve);
+    glDeleteRenderbuffers(1, &color), glDeleteRenderbuffers(1, &depth), glDeleteRenderbuffers(1, &image);
+}
+
+void Framebuffer::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo), glViewport(0, 0, width, height);
+}
+
+/*
+Resolve the rendered image and return its RGBA pixels, bottom row first.
+*/
+std::vector<unsigned char> Framebuffer::read() const {
+    std::vector<unsigned char> pixels(4 * width * height);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo), glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolve);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, resolve), glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    return pixels;
+}
@@ -0,0 +1,103 @@
+#include "framecache.h"
+
+/*
+Create the cache of decoded frames with a memory budget in bytes and start the prefetch thread.
+*/
+FrameCache::FrameCache(std::function<Geometry(size_t)> decode, size_t frames, size_t budget) : decode(decode), frames(frames), budget(budget) {
+    thread = std::thread(&FrameCache::prefetch, this);
+}
+
+FrameCache::~FrameCache() {
+    {std::lock_guard<std::mutex> lock(mutex); stop = true;} condition.notify_one(); thread.join();
+}
+
+/*
+Return the requested frame and mark it as the most recently used one. A missing frame is decoded on the calling thread if
+wait is set, otherwise nullptr is returned and the prefetch thread decodes it in the background. The error of a frame that
+failed to decode on the prefetch thread is rethrown, the prefetching continues past it.
+*/
+std::shared_ptr<const Geometry> FrameCache::get(size_t frame, bool wait) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // update the playback direction and wake up the prefetch thread
+    if (frame != target) {
+        size_t forward = (frame + frames - target) % frames; direction = forward <= frames / 2 ? 1 : -1;
+        target = frame, condition.notify_one();
+    }
+
+    // rethrow the error of the frame
+    if (auto it = failures.find(frame); it != failures.end()) std::rethrow_exception(it->second);
+
+    // return the cached frame
+    if (auto it = cache.find(frame); it != cache.end()) {
+        order.splice(order.begin(), order, it->second.second); return it->second.first;
+    }
+
+    // decode the frame on this thread if requested
+    if (!wait) return nullptr;
+    std::function<Geometry(size_t)> decode = this->decode; size_t generation = this->generation; lock.unlock();
+    std::shared_ptr<const Geometry> geom = std::make_shared<const Geometry>(decode(frame));
+    lock.lock(), insert(frame, geom, generation);
+
+    // return the frame
+    return geom;
+}
+
+
+/*
+Return the requested frame if it is cached, without moving the prefetch target or decoding it.
+*/
+std::shared_ptr<const Geometry> FrameCache::peek(size_t frame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = cache.find(frame); return it != cache.end() ? it->second.first : nullptr;
+}
+/*
+Add the frame to the front of the cache and evict the least recently used frames over the budget. Frames decoded before
+the last reset are dropped. The mutex has to be locked.
+*/
+void FrameCache::insert(size_t frame, const std::shared_ptr<const Geometry>& geom, size_t generation) {
+    if (generation != this->generation || cache.contains(frame)) return;
+    order.push_front(frame), cache[frame] = { geom, order.begin() }, memory += geom->getMemory();
+    while (memory > budget && order.size() > 1) {
+        memory -= cache.at(order.back()).first->getMemory(), cache.erase(order.back()), order.pop_back();
+    }
+}
+
+/*
+Decode the frames ahead of the last requested one in the playback direction. The window is limited to half of the budget so
+that the prefetched frames never evict each other. Frames that fail to decode keep their error and are skipped.
+*/
+void FrameCache::prefetch() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stop) {
+
+        // find the first missing frame in the window
+        size_t window = std::min(frames, cache.empty() ? 1 : budget / 2 / (memory / cache.size() + 1) + 1), missing = frames;
+        for (size_t i = 0; i < window && missing == frames; i++) {
+            size_t frame = (target + frames + direction * (long)i % (long)frames) % frames;
+            if (!cache.contains(frame) && !failures.contains(frame)) missing = frame;
+        }
+
+        // wait for a new request if the window is full
+        if (missing == frames) { condition.wait(lock); continue; }
+
+        // decode the frame without holding the lock
+        std::function<Geometry(size_t)> decode = this->decode; size_t generation = this->generation; lock.unlock();
+        try {
+            Profiler::Scope scope("Prefetch");
+            std::shared_ptr<const Geometry> geom = std::make_shared<const Geometry>(decode(missing));
+            lock.lock(), insert(missing, geom, generation);
+        } catch (...) {
+            if (lock.lock(); generation == this->generation) failures[missing] = std::current_exception();
+        }
+    }
+}
+
+/*
+Replace the decoding function and drop all cached frames and errors, used when the frame parameters change.
+*/
+void FrameCache::reset(std::function<Geometry(size_t)> decode) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->decode = decode, generation++, cache.clear(), order.clear(), failures.clear(), memory = 0;
+    condition.notify_one();
+}
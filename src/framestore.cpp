@@ -0,0 +1,106 @@
+#include "framestore.h"
+
+/*
+Create an empty store for the frames of one topology. The coordinates are quantized to integer steps of the precision and
+padded to whole blocks of STOREBLOCK coordinates.
+*/
+FrameStore::FrameStore(size_t frames, const std::shared_ptr<Topology>& topology, float precision) : topology(topology), records(frames), cells(frames), blocks((3 * topology->size() + STOREBLOCK - 1) / STOREBLOCK), precision(precision) {
+    static std::atomic<size_t> count = 0; id = ++count, bytes = frames * (sizeof(std::vector<uint8_t>) + sizeof(glm::mat3));
+}
+
+/*
+Encode the frames of a group that starts with a keyframe. Every frame stores the differences of its quantized coordinates to
+the previous frame, the keyframe to zero. The blocks of a frame are stored with the smallest width of 0, 1, 2 or 4 bytes that
+holds their differences, so atoms that barely move take a byte per coordinate or nothing. Returns false if a frame has another
+topology or coordinates beyond STORERANGE steps, which the decoding would not restore exactly. Different groups can be
+encoded on different threads.
+*/
+bool FrameStore::encode(size_t group, const std::function<Geometry(size_t)>& decode) {
+    std::vector<int32_t> previous(blocks * STOREBLOCK), current(blocks * STOREBLOCK);
+    for (size_t frame = group * STOREKEYFRAME; frame < std::min(records.size(), (group + 1) * STOREKEYFRAME); frame++) {
+        Geometry geom = decode(frame); const float* values = (const float*)geom.getPositions().data();
+
+        // quantize the coordinates
+        if (geom.getTopology() != topology) return false;
+        for (size_t i = 0; i < 3 * geom.size(); i++) {
+            if (float step = std::round(values[i] / precision); std::abs(step) < STORERANGE) current[i] = (int32_t)step;
+            else return false;
+        }
+
+        // append the widths of the blocks and then their differences
+        std::vector<uint8_t> record(blocks);
+        for (size_t b = 0; b < blocks; b++) {
+            int32_t lower = 0, upper = 0;
+            for (size_t i = b * STOREBLOCK; i < (b + 1) * STOREBLOCK; i++) lower = std::min(lower, current[i] - previous[i]), upper = std::max(upper, current[i] - previous[i]);
+            uint8_t width = record[b] = !lower && !upper ? 0 : lower >= INT8_MIN && upper <= INT8_MAX ? 1 : lower >= INT16_MIN && upper <= INT16_MAX ? 2 : 4;
+            for (size_t i = b * STOREBLOCK; i < (b + 1) * STOREBLOCK && width; i++) {
+                int32_t delta = current[i] - previous[i]; int8_t byte = delta; int16_t word = delta;
+                const uint8_t* value = width == 1 ? (const uint8_t*)&byte : width == 2 ? (const uint8_t*)&word : (const uint8_t*)&delta;
+                record.insert(record.end(), value, value + width);
+            }
+        }
+
+        // store the record and continue from this frame
+        record.shrink_to_fit(), bytes += record.capacity();
+        records.at(frame) = std::move(record), cells.at(frame) = geom.getCell(), std::swap(previous, current);
+    }
+    return true;
+}
+
+/*
+Add the differences of a record to the quantized coordinates. Eight differences at a time are widened to integers and
+converted to floats with AVX, the sums stay exact as they are below STORERANGE.
+*/
+void FrameStore::Apply(const uint8_t* record, size_t blocks, float* state) {
+    const uint8_t* data = record + blocks;
+    for (size_t b = 0; b < blocks; b++, state += STOREBLOCK) {
+        int width = record[b]; if (!width) continue;
+#ifdef __AVX__
+        for (int i = 0; i < STOREBLOCK; i += 8, data += 8 * width) {
+            __m128i low, high;
+            if (width == 1) {
+                __m128i bytes = _mm_loadl_epi64((const __m128i*)data); low = _mm_cvtepi8_epi32(bytes), high = _mm_cvtepi8_epi32(_mm_srli_si128(bytes, 4));
+            } else if (width == 2) {
+                __m128i words = _mm_loadu_si128((const __m128i*)data); low = _mm_cvtepi16_epi32(words), high = _mm_cvtepi16_epi32(_mm_srli_si128(words, 8));
+            } else low = _mm_loadu_si128((const __m128i*)data), high = _mm_loadu_si128((const __m128i*)data + 1);
+            __m256 delta = _mm256_cvtepi32_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(low), high, 1));
+            _mm256_storeu_ps(state + i, _mm256_add_ps(_mm256_loadu_ps(state + i), delta));
+        }
+#else
+        for (int i = 0; i < STOREBLOCK; i++, data += width) {
+            int8_t byte; int16_t word; int32_t dword;
+            if (width == 1) std::memcpy(&byte, data, 1), state[i] += byte;
+            else if (width == 2) std::memcpy(&word, data, 2), state[i] += word;
+            else std::memcpy(&dword, data, 4), state[i] += dword;
+        }
+#endif
+    }
+}
+
+/*
+Decode a frame by adding the records since its keyframe to zero coordinates and scaling them by the precision. Every thread
+keeps the coordinates of the last frame it decoded, so playing forward adds a single record per frame.
+*/
+Geometry FrameStore::getGeom(size_t frame) const {
+    static thread_local struct { size_t id = 0, frame = 0; std::vector<float> state; } last;
+    size_t key = frame - frame % STOREKEYFRAME, start = key;
+
+    // continue from the last frame of this thread if it lies between the keyframe and the frame
+    if (last.id == id && last.frame >= key && last.frame <= frame) start = last.frame + 1;
+    else last.state.assign(blocks * STOREBLOCK, 0);
+    for (size_t i = start; i <= frame; i++) Apply(records.at(i).data(), blocks, last.state.data());
+    last.id = id, last.frame = frame;
+
+    // scale the coordinates into the positions
+    std::vector<glm::vec3> positions(topology->size()); float* values = (float*)positions.data(); size_t i = 0;
+#ifdef __AVX__
+    for (__m256 scale = _mm256_set1_ps(precision); i + 8 <= 3 * positions.size(); i += 8) {
+        _mm256_storeu_ps(values + i, _mm256_mul_ps(_mm256_loadu_ps(last.state.data() + i), scale));
+    }
+#endif
+    for (; i < 3 * positions.size(); i++) values[i] = last.state[i] * precision;
+
+    // return the frame without bonds
+    Geometry geom(topology, std::move(positions), {}); geom.setCell(cells.at(frame));
+    return geom;
+}
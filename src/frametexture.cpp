@@ -0,0 +1,86 @@
+#include "frametexture.h"
+
+/*
+Create the buffer textures of the positions and the elements and the buffers of the atom and bond index pairs. The budget
+is the number of bytes the positions and bonds of the uploaded frames can occupy.
+*/
+FrameTexture::FrameTexture(size_t budget) : budget(budget) {
+    glGenBuffers(1, &positions), glGenBuffers(1, &elements), glGenTextures(2, textures), glGenBuffers(1, &atoms), glGenBuffers(1, &bonds);
+}
+
+FrameTexture::~FrameTexture() {
+    glDeleteBuffers(1, &positions), glDeleteBuffers(1, &elements), glDeleteTextures(2, textures), glDeleteBuffers(1, &atoms), glDeleteBuffers(1, &bonds);
+}
+
+/*
+Upload the chunk of frames starting at the provided one. The chunk continues while the frames share the topology of the
+first one and fit into the budget and the size limit of the buffer texture, the position of an atom is then found at
+frame * natoms + atom relative to the start of the chunk.
+*/
+void FrameTexture::load(const std::vector<Geometry>& geoms, size_t frame) {
+    Profiler::Scope scope("Upload"); int limit; glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &limit);
+    const std::shared_ptr<Topology>& topology = geoms.at(frame).getTopology();
+
+    // find the end of the chunk and the offsets of the bonds of its frames
+    start = end = frame, natoms = geoms.at(frame).size(), offsets = { 0 };
+    while (end < geoms.size() && geoms.at(end).getTopology() == topology) {
+        size_t count = offsets.back() + geoms.at(end).getBonds().size(), size = (end - start + 1) * natoms;
+        if (end > start && (size * sizeof(glm::vec3) + count * sizeof(glm::uvec2) > budget || size > (size_t)limit)) break;
+        offsets.push_back(count), end++;
+    }
+    memory = (end - start) * natoms * sizeof(glm::vec3) + offsets.back() * sizeof(glm::uvec2);
+
+    // upload the positions and the bonds of the frames
+    glBindBuffer(GL_TEXTURE_BUFFER, positions), glBufferData(GL_TEXTURE_BUFFER, (end - start) * natoms * sizeof(glm::vec3), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, bonds), glBufferData(GL_ARRAY_BUFFER, offsets.back() * sizeof(glm::uvec2), nullptr, GL_STATIC_DRAW);
+    for (size_t i = start; i < end; i++) {
+        const std::vector<glm::uvec2>& pairs = geoms.at(i).getBonds();
+        glBufferSubData(GL_TEXTURE_BUFFER, (i - start) * natoms * sizeof(glm::vec3), natoms * sizeof(glm::vec3), geoms.at(i).getPositions().data());
+        glBufferSubData(GL_ARRAY_BUFFER, offsets.at(i - start) * sizeof(glm::uvec2), pairs.size() * sizeof(glm::uvec2), pairs.data());
+    }
+
+    // upload the colors and radii of the atoms and their index pairs
+    std::vector<glm::vec4> colors(natoms); std::vector<glm::uvec2> indices(natoms);
+    for (size_t i = 0; i < natoms; i++) {
+        const std::string& symbol = topology->symbols.at(topology->ids.at(i));
+        colors.at(i) = glm::vec4(ptable.at(symbol).color, topology->radii.at(topology->ids.at(i))), indices.at(i) = glm::uvec2(i, i);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, elements), glBufferData(GL_TEXTURE_BUFFER, natoms * sizeof(glm::vec4), colors.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, atoms), glBufferData(GL_ARRAY_BUFFER, natoms * sizeof(glm::uvec2), indices.data(), GL_STATIC_DRAW);
+
+    // attach the buffers to the textures
+    glBindTexture(GL_TEXTURE_BUFFER, textures[0]), glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, positions);
+    glBindTexture(GL_TEXTURE_BUFFER, textures[1]), glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, elements);
+}
+
+/*
+Render an uploaded frame. Only the offsets of the frame and the following one are set, the shader fetches the positions
+and builds the model matrices of the atoms and bonds, so nothing is sent to the GPU. With a periodic cell the shader can
+wrap the atoms and the bonds are drawn twice, once as the half at each of their atoms.
+*/
+void FrameTexture::render(size_t frame, const Shader& shader, const Shader& sshader, int highlight, const glm::mat3& cell, bool wrap) const {
+    int base = (frame - start) * natoms, next = contains(frame + 1) ? base + natoms : base; bool periodic = Neighbor::Periodic(cell);
+
+    // bind the textures and set the offsets
+    glActiveTexture(GL_TEXTURE1), glBindTexture(GL_TEXTURE_BUFFER, textures[1]);
+    glActiveTexture(GL_TEXTURE0), glBindTexture(GL_TEXTURE_BUFFER, textures[0]);
+    for (const Shader* program : { &shader, &sshader }) {
+        program->use(), program->set<int>("u_resident", 1), program->set<int>("u_positions", 0), program->set<int>("u_elements", 1);
+        program->set<int>("u_base", base), program->set<int>("u_next", next), program->set<int>("u_wrap", periodic && wrap), program->set<int>("u_half", 0);
+        program->set<glm::mat3>("u_cell", cell), program->set<glm::mat3>("u_fraction", periodic ? glm::inverse(cell) : glm::mat3(1));
+    }
+
+    // render the highlighted atom and its outline with a slightly larger sphere
+    if (Mesh& mesh = Geometry::meshes.at("atom"); highlight > -1 && highlight < (int)natoms) {
+        glm::mat4 model = mesh.getModel(); mesh.render(shader, atoms, 1, highlight);
+        mesh.setModel(glm::scale(model, glm::vec3(1.05f))), glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+        mesh.render(sshader, atoms, 1, highlight);
+        mesh.setModel(model), glStencilFunc(GL_ALWAYS, 1, 0xFF);
+    }
+
+    // render the atoms and the bonds of the frame
+    Geometry::meshes.at("atom").render(shader, atoms, natoms);
+    for (int half = periodic; half <= 2 * periodic; half++) {
+        shader.use(), shader.set<int>("u_half", half), Geometry::meshes.at("bond").render(shader, bonds, offsets.at(frame - start + 1) - offsets.at(frame - start), offsets.at(frame - start));
+    }
+}
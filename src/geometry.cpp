@@ -1,142 +1,260 @@
 #include "geometry.h"
 
 /*
-Read the geometry from an .xyz file.
+Read the geometry from one frame of an .xyz file. The topology of the hint is shared if the elements of the frame match it.
+The comment line of the extended format can give the cell vectors as Lattice="..." and the columns of the atom lines as
+Properties=name:type:count:..., of which the species and pos columns are read.
 */
-Geometry Geometry::Load(std::stringstream& file) {
-    // Open file and declare variables
+Geometry Geometry::Load(std::string_view frame, const std::shared_ptr<Topology>& hint, float factor) {
+    // Declare the molecule and the parsing cursor
     Geometry molecule; int length;
-    std::string line, name;
+    const char *pointer = frame.data(), *end = frame.data() + frame.size();
 
-    // Extract length and name.
-    std::getline(file, line);
-    std::getline(file, name);
-    length = std::stoi(line);
+    // Define functions that skip whitespace, lines and read the tokens
+    auto skip = [&]() { while (pointer < end && std::isspace((unsigned char)*pointer)) pointer++; };
+    auto line = [&]() { const char* next = (const char*)std::memchr(pointer, '\n', end - pointer); pointer = next ? next + 1 : end; };
+    auto token = [&]() {
+        skip(); const char* begin = pointer;
+        while (pointer < end && !std::isspace((unsigned char)*pointer)) pointer++;
+        return std::string_view(begin, pointer - begin);
+    };
+    auto number = [&]<typename T>(T& value) {
+        if (skip(); pointer + 1 < end && *pointer == '+' && pointer[1] != '-') pointer++;
+        auto [next, error] = std::from_chars(pointer, end, value);
+        if (error != std::errc()) throw std::runtime_error("Invalid number in the .xyz file.");
+        pointer = next;
+    };
 
-    // Get first line of coordinates
-    std::getline(file, line);
+    // Extract length and parse the extended comment line, by default the species is followed by the position.
+    number(length), line(); const char* comment = pointer; line();
+    std::string_view header(comment, pointer - comment); int species = 0, column = 1, columns = 4;
+    molecule.positions.reserve(length);
+
+    // Read the cell vectors from the lattice.
+    if (size_t start = header.find("Lattice=\""); start != std::string_view::npos) {
+        const char* cursor = header.data() + start + 9;
+        for (int i = 0; i < 9; i++) {
+            while (cursor < pointer && std::isspace((unsigned char)*cursor)) cursor++;
+            if (cursor + 1 < pointer && *cursor == '+' && cursor[1] != '-') cursor++;
+            auto [next, error] = std::from_chars(cursor, pointer, molecule.cell[i / 3][i % 3]);
+            if (error != std::errc()) throw std::runtime_error("Invalid lattice in the .xyz file.");
+            cursor = next;
+        }
+    }
+
+    // Find the token columns of the species and the position from the properties.
+    if (size_t start = header.find("Properties="); start != std::string_view::npos) {
+        std::string_view properties = header.substr(start + 11); properties = properties.substr(0, properties.find_first_of(" \t\r\n"));
+        species = column = -1, columns = 0;
+        while (!properties.empty()) {
+            std::string_view fields[3];
+            for (std::string_view& field : fields) field = properties.substr(0, properties.find(':')), properties.remove_prefix(std::min(properties.size(), field.size() + 1));
+            int count = 0; std::from_chars(fields[2].data(), fields[2].data() + fields[2].size(), count);
+            if (fields[0] == "species") species = columns;
+            if (fields[0] == "pos" && count == 3) column = columns;
+            columns += std::max(count, 1);
+        }
+        if (species < 0 || column < 0) throw std::runtime_error("The .xyz properties need the species and pos columns.");
+    }
+
+    // Start with the hint and fall back to an own topology on the first mismatch.
+    bool shared = hint && (int)hint->size() == length;
+    std::shared_ptr<Topology> topology = std::make_shared<Topology>();
 
     // Add atom for each line.
-    for (int i = 0; i < length; std::getline(file, line), i++) {
-        std::string atom; float x, y, z;
-        std::stringstream iss(line);
-        iss >> atom >> x >> y >> z;
-        glm::mat4 scale = glm::scale(glm::mat4(1), glm::vec3(ATOMSIZEFACTOR * ptable.at(atom).radius));
-        glm::mat4 translate = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
-        molecule.objects.push_back({ translate, glm::mat4(1.0f), scale, atom });
-     }
+    for (int i = 0; i < length; line(), i++) {
+        std::string_view atom; float position[3];
+        for (int j = 0; j < columns; j++) {
+            if (j >= column && j < column + 3) number(position[j - column]);
+            else if (j == species) atom = token();
+            else token();
+        }
+        if (shared && hint->getSymbol(i) != atom) {
+            for (int j = 0; j < i; j++) topology->add(hint->getSymbol(j));
+            shared = false;
+        }
+        if (!shared) topology->add(atom);
+        molecule.positions.push_back({ position[0], position[1], position[2] });
+    }
+    molecule.topology = shared ? hint : topology;
 
     // Add bonds
-    molecule.rebind(BINDINGFACTOR);
+    molecule.rebind(factor);
 
     // Return molecule
     return molecule;
 }
 
+/*
+Returns the model matrix that stretches the bond mesh, a unit cylinder along the y axis, between the two points.
+*/
+glm::mat4 Geometry::Cylinder(const glm::vec3& a, const glm::vec3& b) {
+    glm::vec3 position = (a + b) / 2.0f, vector = b - a;
+    glm::vec3 cross = glm::cross(glm::vec3(0, 1, 0), vector);
+    float angle = atan2f(glm::length(cross), glm::dot(glm::vec3(0, 1, 0), vector));
+    glm::mat4 scale = glm::scale(glm::mat4(1), { 1, glm::length(vector) / 2.0f, 1 });
+    glm::mat4 rotate = glm::rotate(glm::mat4(1), angle, glm::normalize(cross));
+    glm::mat4 translate = glm::translate(glm::mat4(1.0f), position);
+    return translate * rotate * scale;
+}
+
 /*
 Returns the geometric center of the molecule.
 */
 glm::vec3 Geometry::getCenter() const {
     glm::vec3 center(0); float size = 0;
-    for (const Object& object : objects) {
-        if (object.name != "bond" && object.name != "El") {
-            center += object.getPosition(), size += 1;
-        }
+    for (size_t i = 0; i < positions.size(); i++) {
+        if (getSymbol(i) != "El") center += positions.at(i), size += 1;
     }
     return center / size;
 }
 
-
-std::vector<Geometry::Object>& Geometry::getObjects() {
-    return objects;
+/*
+Returns the number of bytes occupied by the frame data.
+*/
+size_t Geometry::getMemory() const {
+    return sizeof(Geometry) + positions.capacity() * sizeof(glm::vec3) + bonds.capacity() * sizeof(glm::uvec2);
 }
 
 /*
 Move the molecule by some vector.
 */
 void Geometry::moveBy(const glm::vec3& vector) {
-    for (Object& object : objects) {
-        object.translate = glm::translate(object.translate, vector);
-    }
+    for (glm::vec3& position : positions) position += vector;
+}
+
+/*
+Apply the matrix to the positions of the atoms, the cell vectors are only rotated.
+*/
+void Geometry::transformBy(const glm::mat4& matrix) {
+    for (glm::vec3& position : positions) position = glm::vec3(matrix * glm::vec4(position, 1));
+    cell = glm::mat3(matrix) * cell;
 }
 
 /*
 Create bonds for atoms based on the binding factor.
 */
 void Geometry::rebind(float factor) {
-    static float bondSize = BONDSIZE;
+    bonds = findBonds(factor);
+};
 
-    std::vector<Object> objects;
-    for (Object obj : this->objects) {
-        if (obj.name != "bond") objects.push_back(obj);
-        else bondSize = obj.scale[0][0];
-    }
+/*
+Return the bonds for the binding factor without changing the geometry, so it can run on a worker thread. There are no bonds
+if the factor is not positive.
+*/
+std::vector<glm::uvec2> Geometry::findBonds(float factor) const {
+    if (factor <= 0) return {};
+    Profiler::Scope scope("Rebind");
 
-    size_t length = objects.size();
-
-    for (size_t i = 0; i < length; i++) {
-        for (size_t j = i + 1; j < length; j++) {
-            float distance = glm::length(objects.at(j).getPosition() - objects.at(i).getPosition());
-            if (objects.at(i).name == "El" || objects.at(j).name == "El") continue;
-            if (distance < factor * (ptable.at(objects.at(i).name).covalent + ptable.at(objects.at(j).name).covalent)) {
-                glm::vec3 position = (objects.at(i).getPosition() + objects.at(j).getPosition()) / 2.0f;
-                glm::vec3 vector = objects.at(j).getPosition() - objects.at(i).getPosition();
-                glm::vec3 cross = glm::cross(glm::vec3(0, 1, 0), vector);
-                float angle = atan2f(glm::length(cross), glm::dot(glm::vec3(0, 1, 0), vector));
-                glm::mat4 scale = glm::scale(glm::mat4(1), { bondSize, glm::length(vector) / 2.0f, bondSize });
-                glm::mat4 rotate = glm::rotate(glm::mat4(1), angle, glm::normalize(cross));
-                glm::mat4 translate = glm::translate(glm::mat4(1.0f), position);
-                objects.push_back({ translate, rotate, scale, "bond" });
-            }
-        }
+    // covalent radii of the elements, the dummy atoms are excluded from bonding
+    std::vector<float> covalent, radii(positions.size());
+    for (const std::string& symbol : topology->symbols) {
+        covalent.push_back(symbol == "El" ? -1 : ptable.at(symbol).covalent);
     }
 
-    this->objects = objects;
-};
+    // create the bonds, consecutive frames bonded on the same thread reuse the candidate pairs
+    static thread_local Neighbor::Verlet verlet;
+    for (size_t i = 0; i < positions.size(); i++) radii.at(i) = covalent.at(topology->ids.at(i));
+    return verlet.bonds(positions, radii, factor, cell);
+}
 
 /*
-Render the geometry
+Render the geometry. The model matrices are built from the positions and the element radii, atoms and bonds are then
+collected into one instance buffer per mesh and drawn with a single call each. The atom size factor and the bond thickness
+are the model matrices of the meshes, so they are applied by the shader. The matrices are also built from the positions of
+the next frame with the bonds of this one, the shader blends them to interpolate between the frames. Atoms and bonds outside
+the view frustum are culled, the visible atoms are grouped by the sphere level of detail chosen from their projected radius,
+so the silhouette error stays below LODERROR pixels. Nothing is culled without the view scale, and impostors or a negative
+level use the atom mesh. In a periodic cell the atoms can be wrapped into the cell and bonds to the nearest image are
+drawn as two halves, so no images of the atoms are needed.
 */
-void Geometry::render(const Shader& shader, const Shader& sshader, int highlight) const {
-    if (int i = highlight; i > -1) {
-        meshes.at(objects.at(i).name).render(shader, objects.at(i).getModel());
+void Geometry::render(const Shader& shader, const Shader& sshader, int highlight, const Geometry* next, const glm::mat4& transform, bool wrap) const {
+    Profiler::Scope scope("Submit"); bool detail = view.scale > 0 && lod >= 0 && !lods.empty();
+    std::vector<std::vector<Instance>> atoms(detail ? std::min<size_t>(lod + 1, lods.size()) : 1); std::vector<Instance> bonds;
+
+    // colors of the elements
+    std::vector<glm::vec3> colors;
+    for (const std::string& symbol : topology->symbols) colors.push_back(ptable.at(symbol).color);
+
+    // positions of the next frame, the frame itself is used if the atoms do not match
+    const std::vector<glm::vec3>& following = next && next->size() == size() ? next->positions : positions;
+
+    // wrap the atoms into a periodic cell, the next positions are the nearest images of the moved atoms, so atoms wrapped back
+    // into the cell between the frames do not sweep across it
+    bool periodic = Neighbor::Periodic(cell); glm::mat3 fraction = periodic ? glm::inverse(cell) : glm::mat3(1);
+    std::vector<glm::vec3> wrapped(periodic && wrap ? size() : 0), shifted(periodic && &following != &positions ? size() : 0);
+    for (size_t i = 0; i < wrapped.size(); i++) wrapped.at(i) = Neighbor::Wrap(positions.at(i), cell, fraction);
+    const std::vector<glm::vec3>& sources = wrapped.empty() ? positions : wrapped;
+    for (size_t i = 0; i < shifted.size(); i++) shifted.at(i) = sources.at(i) + Neighbor::Image(following.at(i) - positions.at(i), cell, fraction);
+    const std::vector<glm::vec3>& targets = shifted.empty() ? (&following == &positions ? sources : following) : shifted;
+
+    // frustum planes in the coordinates of the frame, the pixels per unit at unit depth and the sizes of the meshes
+    glm::mat4 rows = glm::transpose(view.matrix * transform); glm::vec4 planes[6];
+    for (int i = 0; i < 6; i++) planes[i] = i % 2 ? rows[3] - rows[i / 2] : rows[3] + rows[i / 2], planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+    float scale = view.scale * glm::length(glm::vec3(transform[0])), size = glm::length(glm::vec3(meshes.at("atom").getModel()[0]));
+    float thickness = glm::length(glm::vec3(meshes.at("bond").getModel()[0]));
+
+    // function that checks if a bounding sphere intersects the view frustum
+    auto visible = [&](const glm::vec3& center, float radius) {
+        for (int i = 0; i < 6 && view.scale > 0; i++) if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius) return false;
+        return true;
+    };
+
+    // function that returns the sphere level of detail from the projected radius in pixels
+    auto level = [&](const glm::vec3& center, float radius) {
+        float pixels = radius * scale / std::max(glm::dot(glm::vec3(rows[3]), center) + rows[3].w, 1e-6f);
+        return std::clamp((int)std::ceil(std::log2(1.107f * std::sqrt(pixels / (8 * (float)LODERROR)))), 0, (int)atoms.size() - 1);
+    };
+
+    // function that creates the model matrix of an atom
+    auto atom = [this](const std::vector<glm::vec3>& positions, size_t i, float factor = 1) {
+        glm::mat4 model(factor * topology->radii.at(topology->ids.at(i)));
+        return model[3] = glm::vec4(positions.at(i), 1), model;
+    };
+
+    // render the highlighted atom and its outline, the highlight can belong to a frame with more atoms
+    if (int i = highlight; i > -1 && (size_t)i < sources.size()) {
+        meshes.at("atom").render(shader, {{ atom(sources, i), atom(targets, i), colors.at(topology->ids.at(i)) }});
         glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-        meshes.at(objects.at(i).name).render(sshader, objects.at(i).getModel(glm::scale(glm::mat4(1), { 1.05, 1.05, 1.05 })));
-        glStencilFunc(GL_ALWAYS, 1, 0xFF);   
+        meshes.at("atom").render(sshader, {{ atom(sources, i, 1.05f), atom(targets, i, 1.05f) }});
+        glStencilFunc(GL_ALWAYS, 1, 0xFF);
     }
-    for (size_t i = 0; i < objects.size(); i++) {
-        if (objects.at(i).name == "bond") { meshes.at("bond").render(shader, objects.at(i).getModel()); continue; }
-        if (i == (size_t)highlight) continue;
-        meshes.at(objects.at(i).name).render(shader, objects.at(i).getModel());
 
+    // collect the visible atoms into the groups of their levels, the bounding sphere covers the interpolated positions
+    for (size_t i = 0; i < sources.size(); i++) {
+        glm::vec3 center = (sources.at(i) + targets.at(i)) / 2.0f; float radius = size * topology->radii.at(topology->ids.at(i)) + glm::length(targets.at(i) - center);
+        if (i == (size_t)highlight || !visible(center, radius)) continue;
+        atoms.at(detail ? level(center, radius) : 0).push_back({ atom(sources, i), atom(targets, i), colors.at(topology->ids.at(i)) });
     }
-}
 
-/*
-Returns the number of objects (atoms and bonds).
-*/
-void Geometry::setAtomSizeFactor(float factor) {
-    for (Object& obj : this->objects) {
-        if (obj.name != "bond") {
-            obj.scale = glm::scale(glm::mat4(1), glm::vec3(factor * ptable.at(obj.name).radius));
-        }
-    }
-}
+    // collect the visible bonds, the matrix is built once if there is no next frame
+    for (const glm::uvec2& pair : this->bonds) {
+        glm::vec3 a = sources.at(pair.x), b = sources.at(pair.y), c = targets.at(pair.x), d = targets.at(pair.y);
 
-/*
-Sets the bond thickness.
-*/
-void Geometry::setBondSize(float size) {
-    for (Object& obj : this->objects) {
-        if (obj.name == "bond") {
-            obj.scale = glm::scale(glm::mat4(1), { size, obj.scale[1][1], size });
+        // a bond across the faces of a periodic cell is split into halves at its atoms that point to the image of the other one
+        if (periodic) {
+            glm::vec3 u = Neighbor::Image(b - a, cell, fraction), v = Neighbor::Image(d - c, cell, fraction);
+            if (glm::length(u - (b - a)) + glm::length(v - (d - c)) > 1e-3f) {
+                bonds.push_back({ Cylinder(a, a + u / 2.0f), Cylinder(c, c + v / 2.0f) }), bonds.push_back({ Cylinder(b - u / 2.0f, b), Cylinder(d - v / 2.0f, d) });
+                continue;
+            }
         }
+
+        // cull the bond by the sphere around its interpolated ends
+        glm::vec3 center = (a + b + c + d) / 4.0f; float radius = 0;
+        for (const glm::vec3& end : { a, b, c, d }) radius = std::max(radius, glm::length(end - center));
+        if (!visible(center, radius + thickness)) continue;
+        glm::mat4 model = Cylinder(a, b); bonds.push_back({ model, &targets == &sources ? model : Cylinder(c, d) });
     }
+
+    // render the groups of the atoms with their levels of detail and the bonds
+    for (size_t i = 0; i < atoms.size(); i++) (detail ? lods.at(i) : meshes.at("atom")).render(shader, atoms.at(i));
+    meshes.at("bond").render(shader, bonds);
 }
 
 /*
-Returns the number of objects (atoms and bonds).
+Returns the number of atoms.
 */
 size_t Geometry::size() const {
-    return objects.size();
+    return positions.size();
 }
@@ -1,8 +1,5 @@
 #include "gui.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image_write.h>
-
 Gui::Gui(GLFWwindow* window) : window(window) {
     ImGui::CreateContext();
     ImPlot::CreateContext();
@@ -19,23 +16,26 @@ Gui::~Gui() {
 }
 
 void Gui::render(Trajectory& trajectory) {
-    // get the GLFW pointer
-    GLFWPointer* pointer = (GLFWPointer*)glfwGetWindowUserPointer(window);
+    // get the GLFW pointer and start timing the GUI
+    GLFWPointer* pointer = (GLFWPointer*)glfwGetWindowUserPointer(window); Profiler::Scope scope("GUI");
 
     // define some static variables
     static float bindingFactor = BINDINGFACTOR, bondSize = BONDSIZE, atomSizeFactor = ATOMSIZEFACTOR;
     static int subdivisions = SUBDIVISIONS, sectors = SECTORS;
+    static char frames[64] = "", atoms[256] = "", fit[256] = "";
+    static int reference = 1;
+    static bool average = false, edited = false;
+    static float vectors[3][3] = {};
+    static std::string failure;
     static bool smooth = SMOOTH;
 
     // refine functions that recreate the meshes
-    auto remeshCylinders = [](int sectors, bool smooth) {
-        Geometry::meshes.at("bond") = Mesh::Cylinder(sectors, smooth, "bond"); 
+    auto remeshCylinders = [pointer](int sectors, bool smooth) {
+        Geometry::meshes.at("bond") = pointer->flags.impostor ? Mesh::Cube("bond") : Mesh::Cylinder(sectors, smooth, "bond"); 
     };
-    auto remeshSpheres = [](int subdivisions, bool smooth) {
-        for (auto& [symbol, object] : ptable) {
-            Geometry::meshes.at(symbol) = Mesh::Icosphere(subdivisions, smooth, symbol);
-            Geometry::meshes.at(symbol).setColor(object.color);
-        }
+    auto remeshSpheres = [pointer](int subdivisions, bool smooth) {
+        Geometry::meshes.at("atom") = pointer->flags.impostor ? Mesh::Quad("atom") : Mesh::Icosphere(subdivisions, smooth, "atom");
+        Geometry::lod = pointer->flags.impostor ? -1 : subdivisions;
     };
 
     // begin frame
@@ -51,21 +51,31 @@ void Gui::render(Trajectory& trajectory) {
 
         // smooth checkbox
         if (ImGui::Checkbox("Smooth", &smooth)) {
+            for (int i = 0; i < (int)Geometry::lods.size(); i++) Geometry::lods.at(i) = Mesh::Icosphere(i, smooth, "atom");
+            remeshSpheres(subdivisions, smooth);
+            remeshCylinders(sectors, smooth);
+        }
+
+        // impostor checkbox, atoms and bonds are ray-cast on quads and boxes
+        if (ImGui::Checkbox("Impostors", &pointer->flags.impostor)) {
             remeshSpheres(subdivisions, smooth);
             remeshCylinders(sectors, smooth);
         }
 
+        // resident checkbox, the positions are uploaded to the GPU once and the shader fetches them
+        if (!trajectory.isStreamed()) ImGui::Checkbox("GPU Resident", &trajectory.getResident());
+
         // separator
         ImGui::Separator();
 
         // mesh options
-        if (ImGui::SliderInt("Sphere", &subdivisions, 0, 6)) remeshSpheres(subdivisions, smooth);
+        if (ImGui::SliderInt("Sphere", &subdivisions, 0, LODLEVELS)) remeshSpheres(subdivisions, smooth);
         if (ImGui::SliderInt("Cylinder", &sectors, 4, 128)) remeshCylinders(sectors, smooth);
         if (ImGui::SliderFloat("Atom Size Factor", &atomSizeFactor, 0.001, 0.02)) {
-            for (auto& molecule : trajectory.getGeoms()) molecule.setAtomSizeFactor(atomSizeFactor);
+            trajectory.setAtomSizeFactor(atomSizeFactor);
         }
         if (ImGui::SliderFloat("Bond Size", &bondSize, 0.01, 0.2)) {
-            for (auto& molecule : trajectory.getGeoms()) molecule.setBondSize(bondSize);
+            trajectory.setBondSize(bondSize);
         }
 
         //separator
@@ -73,9 +83,12 @@ void Gui::render(Trajectory& trajectory) {
         
         // number factors
         if (ImGui::SliderFloat("Binding Factor", &bindingFactor, 0, 0.05f)) {
-            for (auto& molecule : trajectory.getGeoms()) molecule.rebind(bindingFactor);
+            trajectory.rebind(bindingFactor);
         }
 
+        // progress of the frames rebinding in the background
+        if (float progress = trajectory.getProgress(); progress < 1) ImGui::ProgressBar(progress, ImVec2(-1, 0), "Rebinding");
+
         // separator
         ImGui::Separator();
         
@@ -91,61 +104,111 @@ void Gui::render(Trajectory& trajectory) {
         // trajectory options
         ImGui::SliderInt("Frame", &trajectory.getFrame(), 0, trajectory.size() ? trajectory.size() - 1 : 0);
         ImGui::SliderFloat("Timeout", &trajectory.getWait(), 0.001, 16);
+        ImGui::SliderFloat("Speed", &trajectory.getSpeed(), 0.01, 10, "%.2f", ImGuiSliderFlags_Logarithmic);
+        ImGui::Checkbox("Interpolate", &trajectory.getInterpolate());
 
         // separator
         ImGui::Separator();
         
         // function buttons
-        if (ImGui::Button("Center")) {
-            trajectory.moveBy(-trajectory.getGeoms().at(trajectory.getFrame()).getCenter());
+        if (ImGui::Button("Center") && trajectory.size()) {
+            trajectory.center();
+        }
+        if (ImGui::SameLine(); ImGui::Button("Align") && trajectory.size()) {
+            try { trajectory.align({ reference - 1, average, Writer::Parse("", fit).atoms }); } catch (const std::exception& error) { failure = error.what(); }
+        }
+
+        // alignment options, the frames are superimposed onto the reference frame or the average structure by the atoms
+        ImGui::InputTextWithHint("Align Atoms", "1-10,15", fit, sizeof(fit));
+        ImGui::InputInt("Reference", &reference), ImGui::SameLine(), ImGui::Checkbox("Average", &average);
+
+        // separator
+        ImGui::Separator();
+
+        // periodic cell, the vectors follow the current frame until they are edited and a zero cell removes the periodicity
+        if (!edited && trajectory.size()) for (int i = 0; i < 9; i++) vectors[i / 3][i % 3] = trajectory.getGeom().getCell()[i / 3][i % 3];
+        for (int i = 0; i < 3; i++) edited |= ImGui::InputFloat3((std::string("Cell ") + char('A' + i)).c_str(), vectors[i]);
+        if (ImGui::Button("Apply Cell") && trajectory.size()) {
+            glm::mat3 cell; for (int i = 0; i < 9; i++) cell[i / 3][i % 3] = vectors[i / 3][i % 3];
+            try { trajectory.setCell(cell), edited = false; } catch (const std::exception& error) { failure = error.what(); }
         }
+        ImGui::SameLine(), ImGui::Checkbox("Box", &trajectory.getOutline()), ImGui::SameLine(), ImGui::Checkbox("Wrap", &trajectory.getWrap());
+
+        // separator
+        ImGui::Separator();
+
+        // export selection, empty fields export all frames and atoms
+        ImGui::InputTextWithHint("Export Frames", "start:end:stride", frames, sizeof(frames));
+        ImGui::InputTextWithHint("Export Atoms", "1-10,15", atoms, sizeof(atoms));
 
         // end the window
         ImGui::End();
     }
 
-    // system window
-    if (pointer->flags.system) {
+    // analysis window
+    if (pointer->flags.system && trajectory.size()) {
 
         // begin the window
-        ImGui::Begin("Atom Distance Analysis", &pointer->flags.system, ImGuiWindowFlags_AlwaysAutoResize);
-
-        // current geomery objects and plot atom indices
-        auto objects = trajectory.getGeoms().at(trajectory.getFrame()).getObjects(); int size = 0;
-        for (size_t i = 0; i < objects.size(); i++) if (objects.at(i).name != "bond") size++;
-        static int atom1 = 1, atom2 = 2;
-
-        // coordinate plot data and current frame
-        static std::vector<float> x, y;
-        static int frame = 0;
-
-        // clear if trajectory starts from beginning
-        if (frame > trajectory.getFrame()) x.clear(), y.clear();
-        frame = trajectory.getFrame();
-
-        // atom index sliders
-        if(ImGui::VSliderInt("##Atom 1", ImVec2(15, 255), &atom1, 1, size)) {
-            x.clear(), y.clear();
-        } ImGui::SameLine();
-        if(ImGui::VSliderInt("##Atom 2", ImVec2(15, 255), &atom2, 1, size)) {
-            x.clear(), y.clear();
-        } ImGui::SameLine();
-
-        // push the distane to the y vector
-        if (!pointer->flags.pause || !x.size()) {
-            y.push_back(glm::length(objects.at(atom1 - 1).getPosition() - objects.at(atom2 - 1).getPosition()));
-            x.push_back(x.size() + 1);
+        ImGui::Begin("Geometry Analysis", &pointer->flags.system, ImGuiWindowFlags_AlwaysAutoResize);
+
+        // current geometry positions, the analyzed atom tuples and the tuple being entered
+        const Geometry& geom = trajectory.getGeom();
+        const std::vector<glm::vec3>& positions = geom.getPositions(); int size = positions.size();
+        static std::vector<std::vector<size_t>> tuples;
+        static char tuple[64] = "";
+
+        // function that appends an atom to the tuple
+        auto append = [](int atom) {
+            std::string atoms = tuple; atoms += (atoms.empty() ? "" : " ") + std::to_string(atom + 1); atoms.copy(tuple, sizeof(tuple) - 1)[tuple] = '\0';
+        };
+
+        // append the atom clicked in the viewport
+        if (pointer->picked > -1) append(pointer->picked);
+
+        // begin the group with the tuple input, the series list and the plot
+        ImGui::BeginGroup();
+
+        // add the entered tuple, two atoms give a distance, three an angle and four a dihedral angle
+        ImGui::SetNextItemWidth(240), ImGui::InputTextWithHint("##Tuple", "1 2 3 4", tuple, sizeof(tuple)), ImGui::SameLine();
+        if (ImGui::Button("Add")) {
+            std::vector<size_t> atoms; std::istringstream stream(tuple);
+            for (int atom; stream >> atom;) if (atom > 0 && atom <= size) atoms.push_back(atom - 1);
+            if (atoms.size() > 1 && atoms.size() < 5 && std::find(tuples.begin(), tuples.end(), atoms) == tuples.end()) tuples.push_back(atoms);
+            tuple[0] = '\0';
+        }
+
+        // series labels with their progress and remove buttons, the tuple after a removed one takes its index
+        std::vector<std::pair<std::string, std::shared_ptr<const Analysis::Series>>> series;
+        for (size_t i = 0; i < tuples.size();) {
+            std::string label; for (size_t atom : tuples.at(i)) label += (label.empty() ? "" : "-") + std::to_string(atom + 1);
+            series.emplace_back(label, trajectory.analyze(tuples.at(i))); ImGui::PushID(i); bool removed = ImGui::SmallButton("x");
+            if (removed) tuples.erase(tuples.begin() + i), series.pop_back();
+            else if (ImGui::SameLine(), ImGui::Text("%s", label.c_str()); series.back().second->failed) {
+                ImGui::SameLine(), ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "%s", series.back().second->error.c_str());
+            }
+            else if (!series.back().second->isReady()) {
+                ImGui::SameLine(), ImGui::ProgressBar((float)series.back().second->done / trajectory.size(), ImVec2(120, 0));
+            }
+            ImGui::PopID(), i += !removed;
         }
 
-        // plot
-        if (ImPlot::BeginPlot("Atom Plot", ImVec2(320, 255), ImPlotFlags_NoTitle | ImPlotFlags_NoLegend)) {
-            ImPlot::SetupAxisLimits(ImAxis_X1, x.at(x.size() - 1) - 100, x.at(x.size() - 1), pointer->flags.pause ? ImGuiCond_Once : ImGuiCond_Always);
-            ImPlot::SetupAxis(ImAxis_X1, nullptr, ImPlotAxisFlags_NoTickLabels | ImPlotAxisFlags_NoTickMarks);
-            ImPlot::SetupAxisLimits(ImAxis_Y1, y.at(0) - 0.5, y.at(0) + 0.5);
-            ImPlot::PlotLine("Line", x.data(), y.data(), x.size());
+        // plot the whole trajectory, lengths on the left axis and angles on the right one, the line scrubs the frames
+        if (ImPlot::BeginPlot("Analysis", ImVec2(320, 255), ImPlotFlags_NoTitle)) {
+            ImPlot::SetupAxes("Frame", "Length", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+            ImPlot::SetupAxis(ImAxis_Y2, "Angle", ImPlotAxisFlags_AuxDefault | ImPlotAxisFlags_AutoFit);
+            for (const auto& [label, values] : series) if (values->isReady()) {
+                ImPlot::SetAxes(ImAxis_X1, values->atoms.size() == 2 ? ImAxis_Y1 : ImAxis_Y2);
+                ImPlot::PlotLine(label.c_str(), values->values.data(), values->values.size());
+            }
+            if (double frame = trajectory.getFrame(); ImPlot::DragLineX(0, &frame, ImVec4(1, 1, 1, 0.5f))) {
+                trajectory.getFrame() = std::clamp((int)std::round(frame), 0, trajectory.size() - 1);
+            }
             ImPlot::EndPlot();
         }
 
+        // end the group
+        ImGui::EndGroup();
+
         // coordinate table on the same line
         ImGui::SameLine();
 
@@ -153,28 +216,28 @@ void Gui::render(Trajectory& trajectory) {
         if (ImGui::BeginTable("Atoms", 5, ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersInner | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg, ImVec2(-1, 255))) {
             ImGui::TableSetupColumn("ID"), ImGui::TableSetupColumn("SM"), ImGui::TableSetupColumn("X");
             ImGui::TableSetupColumn("Y"), ImGui::TableSetupColumn("Z"), ImGui::TableSetupScrollFreeze(0, 1);
-            ImGui::TableHeadersRow(); bool hovering = false;
-            for (size_t i = 0; i < objects.size(); i++) {
-                if (objects.at(i).name == "bond") continue;
+            ImGui::TableHeadersRow(); static bool hovered = false; bool hovering = false;
+            for (size_t i = 0; i < positions.size(); i++) {
                 ImGui::PushID(i); bool selected = 0;
                 ImGui::TableNextRow();
                 ImGui::TableNextColumn();
                 ImGui::Text("%d", (int)i + 1);
                 ImGui::TableNextColumn();
-                ImGui::Text("%s", objects.at(i).name.c_str());
+                ImGui::Text("%s", geom.getSymbol(i).c_str());
                 ImGui::TableNextColumn();
-                ImGui::Text("%.3f", objects.at(i).getPosition().x);
+                ImGui::Text("%.3f", positions.at(i).x);
                 ImGui::TableNextColumn();
-                ImGui::Text("%.3f", objects.at(i).getPosition().y);
+                ImGui::Text("%.3f", positions.at(i).y);
                 ImGui::TableNextColumn();
-                ImGui::Text((std::string("%.3f") + (size > 15 ? "  " : "")).c_str(), objects.at(i).getPosition().z);
-                ImGui::SameLine(); ImGui::Selectable("##", selected, ImGuiSelectableFlags_SpanAllColumns);
+                ImGui::Text((std::string("%.3f") + (size > 15 ? "  " : "")).c_str(), positions.at(i).z);
+                ImGui::SameLine(); if (ImGui::Selectable("##", selected, ImGuiSelectableFlags_SpanAllColumns)) append(i);
                 if (ImGui::IsItemHovered()) {
                     pointer->highlight = i, hovering = true;
                 }
                 ImGui::PopID();
             }
-            if (!hovering) pointer->highlight = -1;
+            if (!hovering && hovered) pointer->highlight = -1;
+            hovered = hovering;
             ImGui::EndTable();
         }
 
@@ -183,6 +246,9 @@ void Gui::render(Trajectory& trajectory) {
         ImGui::End();
     }
 
+    // the atom clicked in the viewport is only appended while the analysis window is open
+    pointer->picked = -1;
+
     // periodic table window
     if (pointer->flags.ptable) {
 
@@ -203,6 +269,19 @@ void Gui::render(Trajectory& trajectory) {
             ImGuiWindowFlags_NoFocusOnAppearing
         );
         ImGui::Text("%.1f", ImGui::GetIO().Framerate);
+        if (trajectory.size()) ImGui::Text("%.1f MB/s", trajectory.getThroughput());
+        if (trajectory.getCompression()) ImGui::Text("%.1fx compressed", trajectory.getCompression());
+
+        // stacked breakdown of the frame time over the last frames
+        if (const std::vector<Profiler::Section>& sections = Profiler::Sections(); sections.size() && ImPlot::BeginPlot("Frame Time", ImVec2(320, 160), ImPlotFlags_NoTitle)) {
+            std::vector<float> x(HISTORY), lower(HISTORY), upper(HISTORY); std::iota(x.begin(), x.end(), 0);
+            ImPlot::SetupAxes(nullptr, "ms", ImPlotAxisFlags_NoTickLabels | ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+            for (const Profiler::Section& section : sections) {
+                std::transform(lower.begin(), lower.end(), section.history.begin(), upper.begin(), std::plus<float>());
+                ImPlot::PlotShaded(section.name.c_str(), x.data(), lower.data(), upper.data(), HISTORY), lower = upper;
+            }
+            ImPlot::EndPlot();
+        }
         ImGui::End();
     }
 
@@ -220,30 +299,48 @@ void Gui::render(Trajectory& trajectory) {
         ImGui::End();
     }
 
-    // export the trajectory to the .xyz format
+    // keep the error of a frame that failed to decode during the playback
+    if (!trajectory.getError().empty()) failure = trajectory.getError(), trajectory.getError().clear();
+
+    // collect the finished export and keep its error
+    if (std::unique_ptr<Writer>& exporter = trajectory.getExporter(); exporter && exporter->isDone()) {
+        try { exporter->wait(); } catch (const std::exception& error) { failure = error.what(); }
+        exporter = nullptr;
+    }
+
+    // export window with the progress of the background export or its error
+    if (std::unique_ptr<Writer>& exporter = trajectory.getExporter(); exporter || !failure.empty()) {
+        ImGui::Begin("Export", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoCollapse);
+        if (exporter) {
+            ImGui::ProgressBar(exporter->getProgress(), ImVec2(256, 0));
+            if (ImGui::Button("Cancel")) exporter->cancel();
+        } else {
+            ImGui::Text("%s", failure.c_str());
+            if (ImGui::Button("Close")) failure.clear();
+        }
+        ImGui::End();
+    }
+
+    // time the file dialogs separately
+    scope.next("Dialogs");
+
+    // export the selected frames and atoms in the background, the binary format is selected by the extension
     if (ImGuiFileDialog::Instance()->Display("Export Molecule", ImGuiWindowFlags_NoCollapse, { 512, 288 })) {
         if (ImGuiFileDialog::Instance()->IsOk()) {
-
-            // setup variables for saving the buffer
-            std::ofstream file(ImGuiFileDialog::Instance()->GetFilePathName());
-
-            // iterateover all geoms and write the geometry to the file
-            for (auto geom : trajectory.getGeoms()) {
-                file << geom.size() << "\ntrajectory\n";
-                for (auto object : geom.getObjects()) {
-                    if (object.name == "bond") continue;
-                    file << object.name << " " << object.getPosition().x << " " << object.getPosition().y;
-                    file << " " << object.getPosition().z << "\n";
-                }
-            }
+            try {
+                trajectory.save(ImGuiFileDialog::Instance()->GetFilePathName(), Writer::Parse(frames, atoms));
+            } catch (const std::exception& error) { failure = error.what(); }
         }
         ImGuiFileDialog::Instance()->Close();
     }
 
-    // if importing the molecule open file window
+    // if importing the molecule open file window, the trajectory is replaced only if it loads and the atoms of the old one are no longer highlighted
     if (ImGuiFileDialog::Instance()->Display("Import Molecule", ImGuiWindowFlags_NoCollapse, { 512, 288 })) {
         if (ImGuiFileDialog::Instance()->IsOk()) {
-            trajectory = Trajectory::Load(ImGuiFileDialog::Instance()->GetFilePathName());
+            try {
+                trajectory = Trajectory::Load(ImGuiFileDialog::Instance()->GetFilePathName(), (size_t)pointer->memory << 20, pointer->precision);
+                pointer->highlight = -1, pointer->picked = -1;
+            } catch (const std::exception& error) { failure = error.what(); }
         }
         ImGuiFileDialog::Instance()->Close();
     }
@@ -253,37 +350,18 @@ void Gui::render(Trajectory& trajectory) {
         if (ImGuiFileDialog::Instance()->IsOk()) {
 
             // setup variables for saving the buffer
-            std::string path = ImGuiFileDialog::Instance()->GetFilePathName();
-            std::string extension = path.substr(path.find_last_of(".") + 1);
             GLint viewport[4]; glGetIntegerv(GL_VIEWPORT, viewport);
             int width = viewport[2], height = viewport[3];
-            unsigned char pixels[4 * width * height];
+            std::vector<unsigned char> pixels(4 * width * height);
 
-            // read the buffer
-            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-
-            // flip the image
-            for (int i = 0; i < 4 * width; i++) {
-                for (int j = 0; j < height / 2; j++) {
-                    std::swap(pixels[4 * j * width + i], pixels[4 * (height - j - 1) * width + i]);
-                }
-            }
-
-            // save the buffer
-            if (extension == "png") {
-                stbi_write_png(path.c_str(), width, height, 4, pixels, 4 * width);
-            } else if (extension == "jpg") {
-                stbi_write_jpg(path.c_str(), width, height, 4, pixels, 80);
-            } else if (extension == "bmp") {
-                stbi_write_bmp(path.c_str(), width, height, 4, pixels);
-            } else {
-                throw std::runtime_error("Unknown file extension.");
-            }
+            // read and save the buffer
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            Encoder::Write(ImGuiFileDialog::Instance()->GetFilePathName(), std::move(pixels), width, height);
         }
         ImGuiFileDialog::Instance()->Close();
     }
 
     // render the gui
-    ImGui::Render();
+    scope.next("GUI"), ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
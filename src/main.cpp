@@ -1,21 +1,79 @@
 #include "ptable.h"
+#include "framebuffer.h"
 #include "gui.h"
+#include "uniform.h"
 #include <argparse/argparse.hpp>
 #include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <ImGuiFileDialog.h>
+#include <regex>
 
-std::string vertex = R"(
+// std140 mirror of the Scene block shared by both programs, vec3 members are padded to 16 bytes by the following float
+struct Scene {
+    glm::mat4 view, proj; glm::vec3 camera; float padding0;
+    glm::vec3 position; float ambient, diffuse, specular, shininess, padding1;
+}; static_assert(sizeof(Scene) == 176, "Scene must match the std140 layout.");
+
+// instance inputs, uniforms and functions that interpolate the atoms and bonds, the vertex shaders follow this prelude
+std::string interpolation = R"(
 #version 420 core
+layout(location = 3) in mat4 i_model;
+layout(location = 8) in mat4 i_next;
+layout(location = 12) in uvec2 i_atoms;
+uniform float u_alpha;
+uniform bool u_wrap;
+uniform int u_half;
+uniform mat3 u_cell, u_fraction;
+uniform int u_base, u_next;
+uniform samplerBuffer u_positions, u_elements;
+// position of an atom interpolated towards the nearest image of its next position, the correction vanishes for a zero cell
+vec3 fetch(uint atom) {
+    vec3 position = texelFetch(u_positions, u_base + int(atom)).xyz, motion = texelFetch(u_positions, u_next + int(atom)).xyz - position;
+    return position + (motion - u_cell * round(u_fraction * motion)) * u_alpha;
+}
+// model matrix of an atom or a bond built from the interpolated positions of its atoms in the buffer texture, the atoms
+// can be wrapped into the periodic cell and a periodic bond is drawn as the half at one atom towards the image of the other
+mat4 resident(out vec3 tint) {
+    vec3 a = fetch(i_atoms.x), b = fetch(i_atoms.y);
+    if (u_wrap) a -= u_cell * floor(u_fraction * a), b -= u_cell * floor(u_fraction * b);
+    if (i_atoms.x == i_atoms.y) {
+        vec4 element = texelFetch(u_elements, int(i_atoms.x)); tint = element.rgb;
+        return mat4(vec4(element.w, 0, 0, 0), vec4(0, element.w, 0, 0), vec4(0, 0, element.w, 0), vec4(a, 1));
+    }
+    if (u_half != 0) {
+        vec3 image = u_fraction * (b - a); image = u_cell * (image - round(image));
+        if (u_half == 1) b = a + image / 2; else a = b - image / 2;
+    }
+    vec3 axis = (b - a) / 2, x = normalize(cross(axis, abs(axis.x) < 0.9 * length(axis) ? vec3(1, 0, 0) : vec3(0, 1, 0))); tint = vec3(1);
+    return mat4(vec4(x, 0), vec4(axis, 0), vec4(cross(x, normalize(axis)), 0), vec4((a + b) / 2, 1));
+}
+// model matrix interpolated towards the next one, the blended axis and center follow the interpolated bond ends while the
+// other columns are made orthogonal to the axis again with interpolated lengths, so a rotating bond is not sheared
+mat4 blend() {
+    mat4 model = i_model + (i_next - i_model) * u_alpha; if (length(model[1].xyz) < 1e-6) return model;
+    vec3 y = normalize(model[1].xyz), x = model[0].xyz - dot(model[0].xyz, y) * y;
+    if (length(x) < 1e-6 * length(model[0].xyz)) return model;
+    x = normalize(x), model[0].xyz = x * mix(length(i_model[0].xyz), length(i_next[0].xyz), u_alpha);
+    model[2].xyz = cross(x, y) * mix(length(i_model[2].xyz), length(i_next[2].xyz), u_alpha);
+    return model;
+}
+)";
+
+std::string vertex = R"(
+struct Light { vec3 position; float ambient, diffuse, specular, shininess; };
+layout(std140, binding = 0) uniform Scene { mat4 u_view, u_proj; vec3 u_camera; Light u_light; };
 layout(location = 0) in vec3 i_position;
 layout(location = 1) in vec3 i_normal;
 layout(location = 2) in vec3 i_color;
-uniform mat4 u_model, u_view, u_proj;
+layout(location = 7) in vec3 i_tint;
+uniform mat4 u_model, u_transform;
+uniform bool u_resident;
 out vec3 fragment, normal, color;
 out mat3 transform;
 void main() {
-    normal = normalize(mat3(transpose(inverse(u_model))) * i_normal);
-    fragment = vec3(u_model * vec4(i_position, 1)), color = i_color;
+    vec3 tint = i_tint; mat4 model = u_transform * (u_resident ? resident(tint) : blend()) * u_model;
+    normal = normalize(mat3(transpose(inverse(model))) * i_normal);
+    fragment = vec3(model * vec4(i_position, 1)), color = i_color * tint;
     gl_Position = u_proj * u_view * vec4(fragment, 1);
     transform = inverse(mat3(u_view));
 })";
@@ -23,7 +81,7 @@ void main() {
 std::string fragment = R"(
 #version 420 core
 struct Light { vec3 position; float ambient, diffuse, specular, shininess; };
-uniform Light u_light; uniform vec3 u_camera;
+layout(std140, binding = 0) uniform Scene { mat4 u_view, u_proj; vec3 u_camera; Light u_light; };
 in vec3 fragment, normal, color;
 in mat3 transform;
 out vec4 o_color;
@@ -33,6 +91,56 @@ void main() {
     o_color = vec4((vec3(u_light.ambient) + u_light.diffuse * diffuse + u_light.specular * specular), 1) * vec4(color, 1);
 })";
 
+std::string impostor = R"(
+struct Light { vec3 position; float ambient, diffuse, specular, shininess; };
+layout(std140, binding = 0) uniform Scene { mat4 u_view, u_proj; vec3 u_camera; Light u_light; };
+layout(location = 0) in vec3 i_position;
+layout(location = 7) in vec3 i_tint;
+uniform mat4 u_model, u_transform;
+uniform bool u_resident;
+out vec3 fragment, color;
+flat out vec3 center, axis;
+flat out float radius;
+flat out int shape;
+out mat3 transform;
+void main() {
+    vec3 tint = i_tint; mat4 model = u_transform * (u_resident ? resident(tint) : blend()) * u_model;
+    center = vec3(model[3]), axis = vec3(model[1]), radius = length(vec3(model[0]));
+    shape = i_position.z == 0 ? 0 : 1, color = tint, transform = inverse(mat3(u_view));
+    if (shape == 0) {
+        vec3 view = u_camera - center; float distance = length(view); view /= distance;
+        vec3 u = normalize(cross(abs(view.y) < 0.99 ? vec3(0, 1, 0) : vec3(1, 0, 0), view)), v = cross(view, u);
+        fragment = center + (i_position.x * u + i_position.y * v) * radius * distance / sqrt(max(distance * distance - radius * radius, 1e-6));
+    } else fragment = vec3(model * vec4(i_position, 1));
+    gl_Position = u_proj * u_view * vec4(fragment, 1);
+})";
+
+std::string raycast = R"(
+#version 420 core
+struct Light { vec3 position; float ambient, diffuse, specular, shininess; };
+layout(std140, binding = 0) uniform Scene { mat4 u_view, u_proj; vec3 u_camera; Light u_light; };
+uniform bool u_outline;
+in vec3 fragment, color;
+flat in vec3 center, axis;
+flat in float radius;
+flat in int shape;
+in mat3 transform;
+out vec4 o_color;
+void main() {
+    vec3 ray = normalize(fragment - u_camera), offset = u_camera - center, unit = shape == 0 ? vec3(0) : normalize(axis);
+    vec3 d = ray - dot(ray, unit) * unit, o = offset - dot(offset, unit) * unit;
+    float a = dot(d, d), b = dot(o, d), c = dot(o, o) - radius * radius, discriminant = b * b - a * c;
+    if (discriminant < 0) discard;
+    float t = (-b - sqrt(discriminant)) / a; vec3 hit = u_camera + t * ray; float height = dot(hit - center, unit);
+    if (t < 0 || (shape == 1 && abs(height) > length(axis))) discard;
+    vec4 clip = u_proj * u_view * vec4(hit, 1); gl_FragDepth = 0.5 * clip.z / clip.w + 0.5;
+    if (u_outline) { o_color = vec4(1, 1, 1, 1); return; }
+    vec3 normal = normalize(hit - center - height * unit);
+    vec3 lightPos = transform * u_light.position, reflection = reflect(-normalize(lightPos), normal), direction = normalize(u_camera - hit);
+    vec3 specular = vec3(pow(max(dot(direction, reflection), 0), u_light.shininess)),  diffuse = vec3(max(dot(normal, normalize(lightPos)), 0));
+    o_color = vec4((vec3(u_light.ambient) + u_light.diffuse * diffuse + u_light.specular * specular), 1) * vec4(color, 1);
+})";
+
 std::string stencil = R"(
 #version 420 core
 out vec4 o_color;
@@ -44,10 +152,10 @@ void keyCallback(GLFWwindow* window, int key, int, int action, int mods) {
     if (GLFWPointer* pointer = (GLFWPointer*)glfwGetWindowUserPointer(window); action == GLFW_PRESS) {
         if (mods == GLFW_MOD_CONTROL) {
             if (key == GLFW_KEY_E) {
-                std::string files = "Molecule Files{.allxyz,.xyz},All Files{.*}";
+                std::string files = "Molecule Files{.allxyz,.xyz},Binary Files{.xyzb},All Files{.*}";
                 ImGuiFileDialog::Instance()->OpenDialog("Export Molecule", "Export Molecule", files.c_str(), "");
             } else if (key == GLFW_KEY_O) {
-                std::string files = "Molecule Files{.allxyz,.xyz},All Files{.*}";
+                std::string files = "Molecule Files{.allxyz,.xyz,.extxyz},Trajectory Files{.xtc,.dcd,.xyzb},All Files{.*}";
                 ImGuiFileDialog::Instance()->OpenDialog("Import Molecule", "Import Molecule", files.c_str(), "");
             } else if (key == GLFW_KEY_Q) {
                 glfwSetWindowShouldClose(window, GLFW_TRUE);
@@ -76,6 +184,22 @@ void keyCallback(GLFWwindow* window, int key, int, int action, int mods) {
     }
 }
 
+int pick(const GLFWPointer* pointer, double x, double y) {
+    // unproject the cursor to the near and far plane and pick the atom hit by the ray between them
+    glm::mat4 inverse = glm::inverse(pointer->camera.proj * pointer->camera.view); glm::vec2 ndc(2 * x / pointer->width - 1, 1 - 2 * y / pointer->height);
+    glm::vec4 front = inverse * glm::vec4(ndc, -1, 1), back = inverse * glm::vec4(ndc, 1, 1);
+    return pointer->pick ? pointer->pick(glm::vec3(front) / front.w, glm::vec3(back) / back.w - glm::vec3(front) / front.w) : -1;
+}
+
+void buttonCallback(GLFWwindow* window, int button, int action, int) {
+    GLFWPointer* pointer = (GLFWPointer*)glfwGetWindowUserPointer(window);
+    if (button != GLFW_MOUSE_BUTTON_LEFT || ImGui::GetIO().WantCaptureMouse) return;
+
+    // a release close to the press is a click that picks the atom, otherwise the view was rotated
+    if (action == GLFW_PRESS) pointer->press = pointer->mouse;
+    else if (glm::length(pointer->mouse - pointer->press) < 3) pointer->picked = pick(pointer, pointer->mouse.x, pointer->mouse.y);
+}
+
 void positionCallback(GLFWwindow* window, double x, double y) {
     GLFWPointer* pointer = (GLFWPointer*)glfwGetWindowUserPointer(window);
     if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && !ImGui::GetIO().WantCaptureMouse) {
@@ -84,6 +208,9 @@ void positionCallback(GLFWwindow* window, double x, double y) {
         pointer->camera.view = glm::rotate(pointer->camera.view, 0.01f * ((float)y - pointer->mouse.y), yaxis);
         pointer->camera.view = glm::rotate(pointer->camera.view, 0.01f * ((float)x - pointer->mouse.x), xaxis);
     }
+
+    // highlight the atom under the cursor
+    else if (!ImGui::GetIO().WantCaptureMouse) pointer->highlight = pick(pointer, x, y);
     pointer->mouse = { x, y };
 }
 
@@ -100,16 +227,37 @@ void scrollCallback(GLFWwindow* window, double, double dy) {
     }
 }
 
-void set(const Shader& shader, const GLFWPointer::Camera& camera, const GLFWPointer::Light& light) {
-    shader.use();
-    shader.set<glm::vec3>("u_camera", -glm::inverse(glm::mat3(camera.view)) * glm::vec3(camera.view[3]));
-    shader.set<glm::mat4>("u_view", camera.view);
-    shader.set<glm::mat4>("u_proj", camera.proj);
-    shader.set<glm::vec3>("u_light.position", light.position);
-    shader.set<float>("u_light.shininess", light.shininess);
-    shader.set<float>("u_light.specular", light.specular);
-    shader.set<float>("u_light.ambient", light.ambient);
-    shader.set<float>("u_light.diffuse", light.diffuse);
+void set(const Uniform<Scene>& scene, const GLFWPointer& pointer) {
+    const GLFWPointer::Camera& camera = pointer.camera; const GLFWPointer::Light& light = pointer.light;
+    glm::vec3 position = -glm::inverse(glm::mat3(camera.view)) * glm::vec3(camera.view[3]);
+    scene.upload({ camera.view, camera.proj, position, 0, light.position, light.ambient, light.diffuse, light.specular, light.shininess, 0 });
+
+    // set the culled view and the pixels per unit at unit depth for the levels of detail
+    Geometry::view = { camera.proj * camera.view, camera.proj[1][1] * pointer.height / 2 };
+}
+
+void batch(Trajectory& trajectory, const Shader& shader, const Shader& sshader, const Uniform<Scene>& scene, const GLFWPointer& pointer, const std::string& output, const std::string& range) {
+    // parse the start:end:stride frame range, missing values select all frames
+    Writer::Selection selection = Writer::Parse(range, "");
+    int start = std::clamp(selection.start, 0, trajectory.size()), end = std::clamp(selection.end, 0, trajectory.size()), stride = std::max(selection.stride, 1);
+
+    // create the offscreen framebuffer and the image encoder
+    Framebuffer framebuffer(pointer.width, pointer.height, pointer.samples);
+    Encoder encoder(std::max(2u, std::thread::hardware_concurrency()) - 1);
+    auto timestamp = std::chrono::high_resolution_clock().now();
+
+    // render the frames and queue them for encoding
+    for (int i = start; i < end; i += stride) {
+        framebuffer.bind(), glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        set(scene, pointer);
+        trajectory.render(*trajectory.getGeom(i), shader, sshader);
+        std::vector<char> path(output.size() + 32); std::snprintf(path.data(), path.size(), output.c_str(), i);
+        encoder.push(path.data(), framebuffer.read(), pointer.width, pointer.height);
+    }
+
+    // wait for the encoder and print the throughput
+    encoder.wait(); double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock().now() - timestamp).count();
+    std::cout << "Rendered " << (end - start + stride - 1) / stride << " frames in " << elapsed << " s." << std::endl;
 }
 
 int main(int argc, char** argv) {
@@ -119,6 +267,16 @@ int main(int argc, char** argv) {
     // add options to the parser
     program.add_argument("input").help("Luis input file.").default_value(std::string(""));
     program.add_argument("-h").help("Display this help message and exit.").default_value(false).implicit_value(true);
+    program.add_argument("-m").help("Memory budget for the trajectory frames in MB.").default_value(MEMORY).scan<'i', int>();
+    program.add_argument("-p").help("Precision in Angstrom of the frames kept compressed in memory if they exceed the budget, 0 streams them from the file.").default_value((float)PRECISION).scan<'g', float>();
+    program.add_argument("--render").help("Render the frames offscreen to images named by the printf pattern and exit.").default_value(std::string(""));
+    program.add_argument("--export").help("Export the frames to the file and exit, the .xyzb extension selects the binary format.").default_value(std::string(""));
+    program.add_argument("--frames").help("Frame range start:end:stride rendered to the images or exported.").default_value(std::string(":"));
+    program.add_argument("--atoms").help("Exported atoms as 1-based indices and ranges like 1-10,15.").default_value(std::string(""));
+    program.add_argument("--align").help("Align the loaded frames onto the 1-based reference frame or the average structure.").default_value(std::string(""));
+    program.add_argument("--align-atoms").help("Aligned atoms as 1-based indices and ranges like 1-10,15.").default_value(std::string(""));
+    program.add_argument("--size").help("Size WxH of the rendered images.").default_value(std::to_string(WIDTH) + "x" + std::to_string(HEIGHT));
+    program.add_argument("--trace").help("Write the profiled sections to a Chrome trace event file.").default_value(std::string(""));
 
     // extract the variables from the command line
     try {
@@ -132,13 +290,63 @@ int main(int argc, char** argv) {
         std::cout << program.help().str(); return EXIT_SUCCESS;
     }
 
+    // the image names are formatted with the frame index, so the pattern must have exactly one integer conversion
+    if (std::string pattern = program.get<std::string>("--render"); !pattern.empty() && !std::regex_match(pattern, std::regex(R"(([^%]|%%)*%[-+ #0]*[0-9]*(\.[0-9]*)?[diouxX]([^%]|%%)*)"))) {
+        std::cerr << "Invalid render pattern " << pattern << ", it needs exactly one integer conversion like %04d." << std::endl; return EXIT_FAILURE;
+    }
+
+    // the rendered images need a positive width and height of at most five digits, so they are parsed without overflow
+    if (std::string size = program.get<std::string>("--size"); !std::regex_match(size, std::regex(R"([1-9][0-9]{0,4}x[1-9][0-9]{0,4})"))) {
+        std::cerr << "Invalid image size " << size << ", it needs a positive width and height like 1280x720." << std::endl; return EXIT_FAILURE;
+    }
+
+    // the selections and the reference frame are checked before loading, so malformed ones are usage errors
+    try {
+        Writer::Parse(program.get<std::string>("--frames"), program.get<std::string>("--atoms")), Writer::Parse("", program.get<std::string>("--align-atoms"));
+        if (std::string reference = program.get<std::string>("--align"); !reference.empty() && reference != "average" && !std::regex_match(reference, std::regex("[1-9][0-9]{0,8}"))) {
+            throw std::runtime_error("Invalid reference frame " + reference + ".");
+        }
+    } catch (const std::runtime_error& error) {
+        std::cerr << error.what() << std::endl << std::endl << program; return EXIT_FAILURE;
+    }
+
+    // Function that aligns the loaded trajectory if requested
+    auto align = [&program](Trajectory& trajectory) {
+        if (std::string reference = program.get<std::string>("--align"); !reference.empty() && trajectory.size()) {
+            trajectory.align({ reference == "average" ? 0 : std::stoi(reference) - 1, reference == "average", Writer::Parse("", program.get<std::string>("--align-atoms")).atoms });
+        }
+    };
+
+    // Start recording the trace if requested
+    if (!program.get<std::string>("--trace").empty()) Profiler::Start(program.get<std::string>("--trace"));
+
+    // Export the original coordinates of the trajectory without creating a window if requested
+    if (std::string output = program.get<std::string>("--export"); !output.empty()) {
+        Trajectory trajectory = Trajectory::Load(program.get<std::string>("input"), (size_t)program.get<int>("-m") << 20, program.get<float>("-p")); align(trajectory);
+        Writer::Selection selection = Writer::Parse(program.get<std::string>("--frames"), program.get<std::string>("--atoms"));
+        auto timestamp = std::chrono::high_resolution_clock().now(); trajectory.transformBy(glm::inverse(trajectory.getTransform()));
+        for (trajectory.save(output, selection); !trajectory.getExporter()->isDone(); std::this_thread::sleep_for(std::chrono::milliseconds(100))) {
+            std::cout << "\rExported " << (int)(100 * trajectory.getExporter()->getProgress()) << " %" << std::flush;
+        }
+        trajectory.finish(); double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock().now() - timestamp).count();
+        std::cout << "\rExported " << trajectory.getExporter()->size() << " frames in " << elapsed << " s." << std::endl;
+        Profiler::Stop(); return EXIT_SUCCESS;
+    }
+
+    // Select the platform without a display for the offscreen rendering
+    bool headless = !program.get<std::string>("--render").empty();
+    if (headless) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+
     // Initialize GLFW and throw error if failed
     if(!glfwInit()) {
         throw std::runtime_error("Error during GLFW initialization.");
     }
 
-    // Create GLFW variable struct
-    GLFWPointer pointer; 
+    // Create GLFW variable struct and the exit status of the batch rendering
+    int status = EXIT_SUCCESS; GLFWPointer pointer; pointer.memory = program.get<int>("-m"), pointer.precision = program.get<float>("-p");
+    if (std::string size = program.get<std::string>("--size"); headless) {
+        pointer.width = std::stoi(size.substr(0, size.find('x'))), pointer.height = std::stoi(size.substr(size.find('x') + 1));
+    }
 
     // Pass OpenGL version and other hints
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -146,8 +354,18 @@ int main(int argc, char** argv) {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, pointer.minor);
     glfwWindowHint(GLFW_SAMPLES, pointer.samples);
 
-    // Create the window
-    if (pointer.window = glfwCreateWindow(pointer.width, pointer.height, pointer.title.c_str(), nullptr, nullptr); !pointer.window) {
+    // Request a surfaceless EGL context for the offscreen rendering
+    if (headless) {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API), glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+
+    // Create the window, offscreen rendering falls back to OSMesa
+    pointer.window = glfwCreateWindow(pointer.width, pointer.height, pointer.title.c_str(), nullptr, nullptr);
+    if (!pointer.window && headless) {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        pointer.window = glfwCreateWindow(pointer.width, pointer.height, pointer.title.c_str(), nullptr, nullptr);
+    }
+    if (!pointer.window) {
         throw std::runtime_error("Error during window creation.");
     }
 
@@ -164,6 +382,7 @@ int main(int argc, char** argv) {
 
     // Set event callbacks
     glfwSetCursorPosCallback(pointer.window, positionCallback);
+    glfwSetMouseButtonCallback(pointer.window, buttonCallback);
     glfwSetWindowSizeCallback(pointer.window, resizeCallback);
     glfwSetScrollCallback(pointer.window, scrollCallback);
     glfwSetKeyCallback(pointer.window, keyCallback);
@@ -173,45 +392,56 @@ int main(int argc, char** argv) {
     pointer.camera.view = glm::lookAt({ 0.0f, 0.0f, 5.0f }, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
     {
-        // Initialize meshes
-        for (auto& [symbol, object] : ptable) {
-            Geometry::meshes[symbol] = Mesh::Icosphere(SUBDIVISIONS, SMOOTH, symbol);
-            Geometry::meshes.at(symbol).setColor(object.color);
-        }
+        // Initialize meshes, atom colors are supplied per instance
+        Geometry::meshes["atom"] = Mesh::Icosphere(SUBDIVISIONS, SMOOTH, "atom");
         Geometry::meshes["bond"] = Mesh::Cylinder(SECTORS, SMOOTH, "bond"); 
+        for (int i = 0; i <= LODLEVELS; i++) Geometry::lods.push_back(Mesh::Icosphere(i, SMOOTH, "atom"));
 
         // Create scene, shader and GUI
         Trajectory trajectory;
         if (!program.get<std::string>("input").empty()) {
-            trajectory = Trajectory::Load(program.get<std::string>("input"));
+            trajectory = Trajectory::Load(program.get<std::string>("input"), (size_t)pointer.memory << 20, pointer.precision), align(trajectory);
         }
-        Shader shader(vertex, fragment);
-        Shader sshader(vertex, stencil);
-        Gui gui(pointer.window);
+        pointer.pick = [&trajectory](const glm::vec3& origin, const glm::vec3& direction) { return trajectory.pick(origin, direction); };
+        Shader shader(interpolation + vertex, fragment);
+        Shader sshader(interpolation + vertex, stencil);
+        Shader ishader(interpolation + impostor, raycast);
+        Shader isshader(interpolation + impostor, raycast); isshader.set<int>("u_outline", 1);
+        Uniform<Scene> scene(0);
+
+        // Render the images offscreen instead of opening the GUI, a failed image makes the run fail
+        if (headless) {
+            try {
+                batch(trajectory, shader, sshader, scene, pointer, program.get<std::string>("--render"), program.get<std::string>("--frames"));
+            } catch (const std::exception& error) { std::cerr << error.what() << std::endl, status = EXIT_FAILURE; }
+        } else {
+            Gui gui(pointer.window);
         
-        // Enter the render loop
-        while (!glfwWindowShouldClose(pointer.window)) {
+            // Enter the render loop
+            while (!glfwWindowShouldClose(pointer.window)) {
             
-            // Clear the color and depth buffer
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+                // Finish the profiled frame and clear the color and depth buffer
+                Profiler::Frame(); Profiler::Scope scope("Clear");
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-            // Set shader variables
-            set(sshader, pointer.camera, pointer.light);
-            set(shader, pointer.camera, pointer.light);
+                // Set shader variables
+                set(scene, pointer);
 
-            // Pause or unpause the trajectory
-            trajectory.getPause() = pointer.flags.pause;
+                // Pause or unpause the trajectory
+                trajectory.getPause() = pointer.flags.pause;
 
-            // Render the mesh and GUI
-            trajectory.render(shader, sshader, pointer.highlight);
-            gui.render(trajectory);
+                // Render the mesh and GUI, they time their own sections
+                scope.end(), trajectory.render(pointer.flags.impostor ? ishader : shader, pointer.flags.impostor ? isshader : sshader, pointer.highlight);
+                gui.render(trajectory);
             
-            // Swap buffers and poll events
-            glfwSwapBuffers(pointer.window);
-            glfwPollEvents();
+                // Swap buffers and poll events
+                scope.next("Swap"), glfwSwapBuffers(pointer.window);
+                scope.next("Events"), glfwPollEvents();
+            }
         }
     }
 
-    // Clean up generated meshes and terminate GLFW
-    Geometry::meshes.clear(); glfwTerminate();
+    // Clean up generated meshes, finish the trace and terminate GLFW
+    pointer.pick = nullptr, Geometry::meshes.clear(), Geometry::lods.clear(), Profiler::Stop(); glfwTerminate();
+    return status;
 }
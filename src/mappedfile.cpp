@@ -0,0 +1,45 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+Map the whole file read-only into memory.
+*/
+MappedFile::MappedFile(const std::string& filename) {
+#ifdef _WIN32
+    if (file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr); file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Could not open the file " + filename + ".");
+    }
+    LARGE_INTEGER size; GetFileSizeEx(file, &size); length = size.QuadPart;
+    if (length && (!(mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr)) || !(pointer = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)))) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file); throw std::runtime_error("Could not map the file " + filename + ".");
+    }
+#else
+    if (descriptor = open(filename.c_str(), O_RDONLY); descriptor < 0) {
+        throw std::runtime_error("Could not open the file " + filename + ".");
+    }
+    struct stat info; fstat(descriptor, &info); length = info.st_size;
+    if (void* address = length ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0) : nullptr; address == MAP_FAILED) {
+        close(descriptor); throw std::runtime_error("Could not map the file " + filename + ".");
+    } else pointer = (const char*)address;
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (pointer) UnmapViewOfFile(pointer);
+    if (mapping) CloseHandle(mapping);
+    CloseHandle(file);
+#else
+    if (pointer) munmap((void*)pointer, length);
+    close(descriptor);
+#endif
+}
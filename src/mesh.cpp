@@ -1,145 +1,84 @@
 #include "mesh.h"
 
+// builds the vertex data from shared positions, flat shading needs per face normals so the faces are split
+static std::pair<std::vector<Vertex>, std::vector<unsigned int>> Shade(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, bool smooth) {
+    std::vector<Vertex> data; std::vector<unsigned int> faces;
+    if (smooth) {
+        for (const glm::vec3& position : positions) data.push_back({ position, position });
+        return { data, indices };
+    }
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        glm::vec3 p1 = positions.at(indices.at(i)), p2 = positions.at(indices.at(i + 1)), p3 = positions.at(indices.at(i + 2));
+        glm::vec3 normal = glm::normalize(glm::cross(p2 - p1, p3 - p1));
+        data.push_back({ p1, normal }), data.push_back({ p2, normal }), data.push_back({ p3, normal });
+        faces.push_back((unsigned int)i), faces.push_back((unsigned int)i + 1), faces.push_back((unsigned int)i + 2);
+    }
+    return { data, faces };
+}
+
+Mesh Mesh::Cube(const std::string& name) {
+    std::vector<glm::vec3> positions;
+    for (int i = 0; i < 8; i++) positions.push_back({ i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f });
+    std::vector<unsigned int> indices = {
+        4, 6, 2, 4, 2, 0, 1, 3, 7, 1, 7, 5, 0, 1, 5, 0, 5, 4,
+        6, 7, 3, 6, 3, 2, 2, 3, 1, 2, 1, 0, 4, 5, 7, 4, 7, 6
+    };
+    auto [data, faces] = Shade(positions, indices, true); return Mesh(data, faces, name);
+}
+
 Mesh Mesh::Cylinder(int sectors, bool smooth, const std::string& name) {
-    std::vector<Vertex> data;
+    Profiler::Scope scope("Cylinder");
+    std::vector<glm::vec3> positions; std::vector<unsigned int> indices;
     for (int j = 0; j < sectors; j++) {
-        data.push_back({{ cosf(2 * (float)M_PI / sectors * (j + 0)),  1, sinf(2 * (float)M_PI / sectors * (j + 0)) }});
-        data.push_back({{ cosf(2 * (float)M_PI / sectors * (j + 1)),  1, sinf(2 * (float)M_PI / sectors * (j + 1)) }});
-        data.push_back({{ cosf(2 * (float)M_PI / sectors * (j + 1)), -1, sinf(2 * (float)M_PI / sectors * (j + 1)) }});
-
-        data.push_back({{ cosf(2 * (float)M_PI / sectors * (j + 0)),  1, sinf(2 * (float)M_PI / sectors * (j + 0)) }});
-        data.push_back({{ cosf(2 * (float)M_PI / sectors * (j + 1)), -1, sinf(2 * (float)M_PI / sectors * (j + 1)) }});
-        data.push_back({{ cosf(2 * (float)M_PI / sectors * (j + 0)), -1, sinf(2 * (float)M_PI / sectors * (j + 0)) }});
+        positions.push_back({ cosf(2 * (float)M_PI / sectors * j),  1, sinf(2 * (float)M_PI / sectors * j) });
+        positions.push_back({ cosf(2 * (float)M_PI / sectors * j), -1, sinf(2 * (float)M_PI / sectors * j) });
     }
-    for (size_t i = 0; i < data.size(); i += 3) {
-        glm::vec3 v1 = data.at(i + 1).position - data.at(i).position;
-        glm::vec3 v2 = data.at(i + 2).position - data.at(i).position;
-        data.at(i + 0).normal = smooth ? data.at(i + 0).position : glm::normalize(glm::cross(v1, v2));
-        data.at(i + 1).normal = smooth ? data.at(i + 1).position : glm::normalize(glm::cross(v1, v2));
-        data.at(i + 2).normal = smooth ? data.at(i + 2).position : glm::normalize(glm::cross(v1, v2));
+    for (unsigned int j = 0, n = 2 * sectors; j < n; j += 2) {
+        indices.insert(indices.end(), { j, (j + 2) % n, (j + 3) % n });
+        indices.insert(indices.end(), { j, (j + 3) % n, j + 1 });
     }
-    return Mesh(data, name);
+    auto [data, faces] = Shade(positions, indices, smooth); return Mesh(data, faces, name);
 }
 
 Mesh Mesh::Icosphere(int subdivisions, bool smooth, const std::string& name) {
-    std::vector<Vertex> data; float k = (1.0f + sqrtf(5.0f)) / 2.0f;
-
-    data.push_back({glm::normalize(glm::vec3{ -1,  k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{ -k,  0,  1 })});
-    data.push_back({glm::normalize(glm::vec3{  0,  1,  k })});
-
-    data.push_back({glm::normalize(glm::vec3{ -1,  k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{  0,  1,  k })});
-    data.push_back({glm::normalize(glm::vec3{  1,  k,  0 })});
-
-    data.push_back({glm::normalize(glm::vec3{ -1,  k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{  1,  k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{  0,  1, -k })});
-
-    data.push_back({glm::normalize(glm::vec3{ -1,  k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{  0,  1, -k })});
-    data.push_back({glm::normalize(glm::vec3{ -k,  0, -1 })});
-
-    data.push_back({glm::normalize(glm::vec3{ -1,  k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{ -k,  0, -1 })});
-    data.push_back({glm::normalize(glm::vec3{ -k,  0,  1 })});
-
-    data.push_back({glm::normalize(glm::vec3{  1,  k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{  0,  1,  k })});
-    data.push_back({glm::normalize(glm::vec3{  k,  0,  1 })});
-
-    data.push_back({glm::normalize(glm::vec3{  0,  1,  k })});
-    data.push_back({glm::normalize(glm::vec3{ -k,  0,  1 })});
-    data.push_back({glm::normalize(glm::vec3{  0, -1,  k })});
-
-    data.push_back({glm::normalize(glm::vec3{ -k,  0,  1 })});
-    data.push_back({glm::normalize(glm::vec3{ -k,  0, -1 })});
-    data.push_back({glm::normalize(glm::vec3{ -1, -k,  0 })});
-
-    data.push_back({glm::normalize(glm::vec3{ -k,  0, -1 })});
-    data.push_back({glm::normalize(glm::vec3{  0,  1, -k })});
-    data.push_back({glm::normalize(glm::vec3{  0, -1, -k })});
-
-    data.push_back({glm::normalize(glm::vec3{  0,  1, -k })});
-    data.push_back({glm::normalize(glm::vec3{  1,  k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{  k,  0, -1 })});
-
-    data.push_back({glm::normalize(glm::vec3{  0, -1,  k })});
-    data.push_back({glm::normalize(glm::vec3{  k,  0,  1 })});
-    data.push_back({glm::normalize(glm::vec3{  0,  1,  k })});
-
-    data.push_back({glm::normalize(glm::vec3{ -1, -k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{  0, -1,  k })});
-    data.push_back({glm::normalize(glm::vec3{ -k,  0,  1 })});
-
-    data.push_back({glm::normalize(glm::vec3{  0, -1, -k })});
-    data.push_back({glm::normalize(glm::vec3{ -1, -k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{ -k,  0, -1 })});
-
-    data.push_back({glm::normalize(glm::vec3{  k,  0, -1 })});
-    data.push_back({glm::normalize(glm::vec3{  0, -1, -k })});
-    data.push_back({glm::normalize(glm::vec3{  0,  1, -k })});
-
-    data.push_back({glm::normalize(glm::vec3{  k,  0,  1 })});
-    data.push_back({glm::normalize(glm::vec3{  k,  0, -1 })});
-    data.push_back({glm::normalize(glm::vec3{  1,  k,  0 })});
-
-    data.push_back({glm::normalize(glm::vec3{  1, -k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{  k,  0,  1 })});
-    data.push_back({glm::normalize(glm::vec3{  0, -1,  k })});
-
-    data.push_back({glm::normalize(glm::vec3{  1, -k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{  0, -1,  k })});
-    data.push_back({glm::normalize(glm::vec3{ -1, -k,  0 })});
-
-    data.push_back({glm::normalize(glm::vec3{  1, -k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{ -1, -k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{  0, -1, -k })});
-
-    data.push_back({glm::normalize(glm::vec3{  1, -k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{  0, -1, -k })});
-    data.push_back({glm::normalize(glm::vec3{  k,  0, -1 })});
-
-    data.push_back({glm::normalize(glm::vec3{  1, -k,  0 })});
-    data.push_back({glm::normalize(glm::vec3{  k,  0, -1 })});
-    data.push_back({glm::normalize(glm::vec3{  k,  0,  1 })});
-
+    Profiler::Scope scope("Icosphere");
+    float k = (1.0f + sqrtf(5.0f)) / 2.0f;
+
+    // vertices and faces of the icosahedron
+    std::vector<glm::vec3> positions = {
+        { -1,  k,  0 }, {  1,  k,  0 }, { -1, -k,  0 }, {  1, -k,  0 },
+        {  0, -1,  k }, {  0,  1,  k }, {  0, -1, -k }, {  0,  1, -k },
+        {  k,  0, -1 }, {  k,  0,  1 }, { -k,  0, -1 }, { -k,  0,  1 }
+    };
+    std::vector<unsigned int> indices = {
+        0, 11,  5, 0,  5,  1, 0,  1,  7, 0,  7, 10, 0, 10, 11,
+        1,  5,  9, 5, 11,  4, 11, 10, 2, 10,  7,  6, 7,  1,  8,
+        4,  9,  5, 2,  4, 11, 6,  2, 10, 8,  6,  7, 9,  8,  1,
+        3,  9,  4, 3,  4,  2, 3,  2,  6, 3,  6,  8, 3,  8,  9
+    };
+    std::for_each(positions.begin(), positions.end(), [](glm::vec3& p) { p = glm::normalize(p); });
+
+    // split every face into four, the midpoint of each edge is created only once
     for (int i = 0; i < subdivisions; i++) {
-        std::vector<Vertex> subdivided;
-        for (size_t j = 0; j < data.size(); j += 3) {
-            glm::vec3 p1 = data.at(j + 0).position;
-            glm::vec3 p2 = data.at(j + 1).position;
-            glm::vec3 p3 = data.at(j + 2).position;
-            glm::vec3 p4 = glm::normalize((p1 + p2) / 2.0f);
-            glm::vec3 p5 = glm::normalize((p2 + p3) / 2.0f);
-            glm::vec3 p6 = glm::normalize((p3 + p1) / 2.0f);
-
-            subdivided.push_back({p1});
-            subdivided.push_back({p4});
-            subdivided.push_back({p6});
-
-            subdivided.push_back({p4});
-            subdivided.push_back({p2});
-            subdivided.push_back({p5});
-
-            subdivided.push_back({p6});
-            subdivided.push_back({p5});
-            subdivided.push_back({p3});
-
-            subdivided.push_back({p4});
-            subdivided.push_back({p5});
-            subdivided.push_back({p6});
+        std::unordered_map<unsigned long long, unsigned int> midpoints; std::vector<unsigned int> subdivided;
+        auto midpoint = [&](unsigned int a, unsigned int b) {
+            auto [it, inserted] = midpoints.try_emplace((unsigned long long)std::min(a, b) << 32 | std::max(a, b), (unsigned int)positions.size());
+            if (inserted) positions.push_back(glm::normalize((positions.at(a) + positions.at(b)) / 2.0f));
+            return it->second;
+        };
+        for (size_t j = 0; j < indices.size(); j += 3) {
+            unsigned int p1 = indices.at(j + 0), p2 = indices.at(j + 1), p3 = indices.at(j + 2);
+            unsigned int p4 = midpoint(p1, p2), p5 = midpoint(p2, p3), p6 = midpoint(p3, p1);
+            subdivided.insert(subdivided.end(), { p1, p4, p6, p4, p2, p5, p6, p5, p3, p4, p5, p6 });
         }
-        data = subdivided;
-    }
-    for (size_t i = 0; i < data.size(); i += 3) {
-        glm::vec3 v1 = data.at(i + 1).position - data.at(i).position;
-        glm::vec3 v2 = data.at(i + 2).position - data.at(i).position;
-        data.at(i + 0).normal = smooth ? data.at(i + 0).position : glm::normalize(glm::cross(v1, v2));
-        data.at(i + 1).normal = smooth ? data.at(i + 1).position : glm::normalize(glm::cross(v1, v2));
-        data.at(i + 2).normal = smooth ? data.at(i + 2).position : glm::normalize(glm::cross(v1, v2));
+        indices = subdivided;
     }
-    return Mesh(data, name);
+    auto [data, faces] = Shade(positions, indices, smooth); return Mesh(data, faces, name);
+}
+
+Mesh Mesh::Quad(const std::string& name) {
+    std::vector<glm::vec3> positions = {{ -1, -1, 0 }, { 1, -1, 0 }, { 1, 1, 0 }, { -1, 1, 0 }};
+    auto [data, faces] = Shade(positions, { 0, 1, 2, 0, 2, 3 }, true); return Mesh(data, faces, name);
 }
 
 std::string Mesh::getName() const {
@@ -150,15 +89,18 @@ glm::vec3 Mesh::getPosition() const {
     return glm::vec3(model[3]);
 }
 
-void Mesh::render(const Shader& shader, const glm::mat4& transform) const {
-    shader.use(), shader.set<glm::mat4>("u_model", transform * model);
-    buffer.bind(), glDrawArrays(GL_TRIANGLES, 0, (int)buffer.getSize());
+void Mesh::render(const Shader& shader, const std::vector<Instance>& instances) const {
+    if (instances.empty()) return;
+    shader.use(), shader.set<glm::mat4>("u_model", model);
+    buffer.bind(), buffer.attach(), buffer.upload(instances);
+    glDrawElementsInstanced(GL_TRIANGLES, (int)buffer.getSize(), GL_UNSIGNED_INT, nullptr, (int)instances.size());
 }
 
-void Mesh::setColor(const glm::vec3& color) {
-    std::vector<Vertex> data = buffer.getData();
-    std::for_each(data.begin(), data.end(), [color](Vertex& v) { v.color = color; });
-    buffer = Buffer(data);
+void Mesh::render(const Shader& shader, unsigned int pairs, int count, int base) const {
+    if (count == 0) return;
+    shader.use(), shader.set<glm::mat4>("u_model", model);
+    buffer.bind(), buffer.attach(pairs);
+    glDrawElementsInstancedBaseInstance(GL_TRIANGLES, (int)buffer.getSize(), GL_UNSIGNED_INT, nullptr, count, base);
 }
 
 void Mesh::setModel(const glm::mat4& model) {
@@ -0,0 +1,143 @@
+#include "neighbor.h"
+
+/*
+Find all atom pairs closer than the factor multiplied by the sum of their radii. Atoms are binned into a uniform grid with
+the cell size equal to the longest possible bond, so only the 27 neighboring cells of each atom have to be searched.
+Atoms with a negative radius are excluded. The pairs are returned sorted, the same order as a plain double loop would give.
+A positive skin is added to the bond length, which gives the candidate pairs of a Verlet list. In a periodic cell the grid
+divides the fractional coordinates, so the cells of a triclinic grid are at least the cutoff wide across their faces, the
+grid wraps at the faces and the distances are the minimum images.
+*/
+std::vector<glm::uvec2> Neighbor::Bonds(const std::vector<glm::vec3>& positions, const std::vector<float>& radii, float factor, float skin, const glm::mat3& cell) {
+    // the longest possible bond sets the cell size
+    float cutoff = 0; for (float radius : radii) cutoff = std::max(cutoff, 2 * factor * radius);
+    if (positions.empty() || cutoff <= 0) return {};
+    cutoff += skin;
+
+    // bounding box of the binned atoms
+    glm::vec3 lower(INFINITY), upper(-INFINITY);
+    for (size_t i = 0; i < positions.size(); i++) {
+        if (radii.at(i) >= 0) lower = glm::min(lower, positions.at(i)), upper = glm::max(upper, positions.at(i));
+    }
+    if (lower.x > upper.x) return {};
+
+    // the widths of a periodic cell across its faces are the inverse lengths of the rows of the fraction matrix
+    bool periodic = Periodic(cell); glm::mat3 fraction = periodic ? glm::inverse(cell) : glm::mat3(1); glm::vec3 width = upper - lower;
+    for (int k = 0; k < 3 && periodic; k++) width[k] = 1 / glm::length(glm::vec3(fraction[0][k], fraction[1][k], fraction[2][k]));
+
+    // enlarge the cells of sparse systems so that the grid stays proportional to the atom count
+    float size = 1.0001f * cutoff; size_t n[3];
+    for (;; size *= 2) {
+        for (int k = 0; k < 3; k++) n[k] = periodic ? std::max<size_t>((size_t)((double)width[k] / size), 1) : (size_t)((double)width[k] / size) + 1;
+        if ((double)n[0] * n[1] * n[2] <= 8.0 * positions.size() + 64) break;
+    }
+    size_t nx = n[0], ny = n[1], nz = n[2];
+
+    // sort the atoms by their cell with a counting sort, periodic atoms are binned by their wrapped fractional coordinates
+    std::vector<unsigned int> bin(positions.size()), start(nx * ny * nz + 1), atoms; std::vector<glm::vec3> fractions(periodic ? positions.size() : 0);
+    for (size_t i = 0; i < positions.size(); i++) {
+        if (radii.at(i) < 0) continue;
+        glm::vec3 index = (positions.at(i) - lower) / size;
+        if (periodic) fractions.at(i) = fraction * positions.at(i), fractions.at(i) -= glm::floor(fractions.at(i)), index = fractions.at(i) * glm::vec3(nx, ny, nz);
+        bin.at(i) = (unsigned int)((std::min((size_t)index.z, nz - 1) * ny + std::min((size_t)index.y, ny - 1)) * nx + std::min((size_t)index.x, nx - 1));
+        start.at(bin.at(i) + 1)++;
+    }
+    for (size_t i = 1; i < start.size(); i++) start.at(i) += start.at(i - 1);
+    atoms.resize(start.back()); std::vector<unsigned int> fill(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < positions.size(); i++) if (radii.at(i) >= 0) atoms.at(fill.at(bin.at(i))++) = i;
+
+    // function that lists the distinct neighboring cells along an axis, the periodic ones wrap around
+    auto around = [periodic](size_t x, size_t n, size_t neighbors[3]) {
+        size_t count = 0;
+        for (size_t y : { x + n - 1, x + n, x + n + 1 }) {
+            if (!periodic && (y < n || y >= 2 * n)) continue;
+            if (std::find(neighbors, neighbors + count, y % n) == neighbors + count) neighbors[count++] = y % n;
+        }
+        return count;
+    };
+
+    // search the pairs of a contiguous range of cells
+    auto search = [&](size_t begin, size_t end, std::vector<glm::uvec2>& pairs) {
+        for (size_t c = begin; c < end; c++) {
+            size_t xs[3], ys[3], zs[3], cx = around(c % nx, nx, xs), cy = around(c / nx % ny, ny, ys), cz = around(c / (nx * ny), nz, zs);
+            for (size_t k = 0; k < cz; k++) {
+                for (size_t l = 0; l < cy; l++) {
+                    for (size_t m = 0; m < cx; m++) {
+                        size_t d = (zs[k] * ny + ys[l]) * nx + xs[m];
+                        for (unsigned int a = start.at(c); a < start.at(c + 1); a++) {
+                            for (unsigned int b = start.at(d); b < start.at(d + 1); b++) {
+                                unsigned int i = atoms.at(a), j = atoms.at(b);
+                                if (j <= i) continue;
+                                glm::vec3 s = periodic ? fractions.at(j) - fractions.at(i) : glm::vec3(0);
+                                float distance = glm::length(periodic ? cell * (s - glm::round(s)) : positions.at(j) - positions.at(i));
+                                if (distance < factor * (radii.at(i) + radii.at(j)) + skin) pairs.push_back({ i, j });
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    // split the cells between threads for large systems
+    size_t nthread = positions.size() < PARALLELTHRESHOLD ? 1 : std::max(1u, std::thread::hardware_concurrency());
+    size_t ncell = nx * ny * nz; std::vector<std::vector<glm::uvec2>> pairs(nthread);
+    if (nthread == 1) search(0, ncell, pairs.at(0));
+    else {
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < nthread; i++) {
+            threads.emplace_back(search, i * ncell / nthread, (i + 1) * ncell / nthread, std::ref(pairs.at(i)));
+        }
+        for (std::thread& thread : threads) thread.join();
+    }
+
+    // merge and sort the pairs
+    std::vector<glm::uvec2> bonds;
+    for (const std::vector<glm::uvec2>& part : pairs) bonds.insert(bonds.end(), part.begin(), part.end());
+    std::sort(bonds.begin(), bonds.end(), [](const glm::uvec2& a, const glm::uvec2& b) {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+
+    // return the bonds
+    return bonds;
+}
+
+/*
+Find the bonds from the candidate pairs. The candidates are searched again only if the atoms, their radii or the factor
+change, or if an atom moved by more than half of the skin since the last search, so no bond can be missed in between. If
+the candidates do not survive a single frame, the atoms move too fast for the skin and the plain search is used for a while.
+A changing periodic cell moves the images by at most the summed change of its vectors, which is taken from the skin, and
+atoms that are wrapped back into the cell do not count as moved.
+*/
+std::vector<glm::uvec2> Neighbor::Verlet::bonds(const std::vector<glm::vec3>& positions, const std::vector<float>& radii, float factor, const glm::mat3& cell) {
+    if (skip > 0) return skip--, Bonds(positions, radii, factor, 0, cell);
+    bool periodic = Periodic(cell); glm::mat3 fraction = periodic ? glm::inverse(cell) : glm::mat3(1);
+
+    // check if the candidates are still valid
+    float drift = 0; for (int k = 0; k < 3; k++) drift += glm::length(cell[k] - this->cell[k]);
+    bool valid = positions.size() == reference.size() && factor == this->factor && radii == this->radii && periodic == Periodic(this->cell) && drift < SKIN;
+    for (size_t i = 0; i < positions.size() && valid; i++) {
+        glm::vec3 displacement = periodic ? Image(positions[i] - reference[i], cell, fraction) : positions[i] - reference[i];
+        valid = 4 * glm::dot(displacement, displacement) <= (SKIN - drift) * (SKIN - drift);
+    }
+
+    // search the candidates again if not
+    if (!valid) {
+        if (age == 1 && positions.size() == reference.size()) return skip = 16, age = 0, reference.clear(), Bonds(positions, radii, factor, 0, cell);
+        candidates = Bonds(positions, radii, factor, SKIN, cell), reference = positions, this->radii = radii, this->factor = factor, this->cell = cell, age = 0;
+        cutoffs.resize(candidates.size());
+        for (size_t i = 0; i < candidates.size(); i++) cutoffs[i] = factor * (radii[candidates[i].x] + radii[candidates[i].y]);
+    }
+
+    // keep the candidates that are bonded in this frame, about half of them are so the loop is kept branchless
+    std::vector<glm::uvec2> bonds(candidates.size()); size_t count = 0; age++;
+    if (periodic) for (size_t i = 0; i < candidates.size(); i++) {
+        bonds[count] = candidates[i], count += glm::length(Image(positions[candidates[i].y] - positions[candidates[i].x], cell, fraction)) < cutoffs[i];
+    }
+    else for (size_t i = 0; i < candidates.size(); i++) {
+        bonds[count] = candidates[i], count += glm::length(positions[candidates[i].y] - positions[candidates[i].x]) < cutoffs[i];
+    }
+
+    // return the bonds
+    return bonds.resize(count), bonds;
+}
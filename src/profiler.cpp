@@ -0,0 +1,70 @@
+#include "profiler.h"
+
+// nesting depth of the scopes on the current thread and the thread index used in the trace
+static thread_local int depth = 0;
+static std::atomic<int> threads = 0;
+static thread_local int tid = threads++;
+
+/*
+End the current section and start the next one in the same scope.
+*/
+void Profiler::Scope::next(const char* name) {
+    end(), depth++, this->name = name, start = std::chrono::steady_clock::now();
+}
+
+/*
+End the current section, the sections called afterwards are no longer nested in it.
+*/
+void Profiler::Scope::end() {
+    if (name) depth--, Record(name, start, std::chrono::steady_clock::now()), name = nullptr;
+}
+
+/*
+Finish the frame on the calling thread. The outermost sections recorded on this thread since the last call are appended to
+their history, which makes them a non-overlapping breakdown of the frame time.
+*/
+void Profiler::Frame() {
+    thread = std::this_thread::get_id();
+    for (Section& section : sections) {
+        std::rotate(section.history.begin(), section.history.begin() + 1, section.history.end());
+        section.history.back() = section.total, section.total = 0;
+    }
+
+    // write the collected trace events
+    if (std::lock_guard<std::mutex> lock(mutex); tracing && buffer.size() > 1 << 16) file << buffer, buffer.clear();
+}
+
+/*
+Record the section to the frame breakdown and to the trace.
+*/
+void Profiler::Record(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    if (depth == 0 && std::this_thread::get_id() == thread) {
+        auto it = std::find_if(sections.begin(), sections.end(), [name](const Section& section) { return section.name == name; });
+        if (it == sections.end()) it = sections.insert(sections.end(), { name });
+        it->total += std::chrono::duration<float, std::milli>(end - start).count();
+    }
+    if (tracing) {
+        long long ts = std::chrono::duration_cast<std::chrono::microseconds>(start - epoch).count();
+        long long dur = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        std::string event = ",\n{\"name\":\"" + std::string(name) + "\",\"ph\":\"X\",\"ts\":" + std::to_string(ts) + ",\"dur\":" + std::to_string(dur) + ",\"pid\":0,\"tid\":" + std::to_string(tid) + "}";
+        std::lock_guard<std::mutex> lock(mutex); buffer += event;
+    }
+}
+
+/*
+Start writing the recorded sections to the file in the Chrome trace event format.
+*/
+void Profiler::Start(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex); file.open(path);
+    if (!file.good()) throw std::runtime_error("Could not open the file " + path + ".");
+    file << "{\"traceEvents\":[\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid << ",\"args\":{\"name\":\"main\"}}", tracing = true;
+}
+
+/*
+Write the remaining events and close the trace file.
+*/
+void Profiler::Stop() {
+    if (std::lock_guard<std::mutex> lock(mutex); tracing) {
+        file << buffer << "\n]}\n", buffer.clear(), file.close(), tracing = false;
+    }
+}
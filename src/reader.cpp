@@ -0,0 +1,383 @@
+#include "reader.h"
+
+// the sizes of the small differences of the xtc coordinates, indexed by the bit count of three of them
+static const int magicints[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 10, 12, 16, 20, 25, 32, 40, 50, 64, 80, 101, 128, 161, 203, 256, 322, 406, 512, 645, 812, 1024, 1290,
+    1625, 2048, 2580, 3250, 4096, 5060, 6501, 8192, 10321, 13003, 16384, 20642, 26007, 32768, 41285, 52015, 65536, 82570, 104031,
+    131072, 165140, 208063, 262144, 330280, 416127, 524287, 660561, 832255, 1048576, 1321122, 1664510, 2097152, 2642245, 3329021,
+    4194304, 5284491, 6658042, 8388607, 10568983, 13316085, 16777216
+};
+static const int FIRSTIDX = 9, LASTIDX = sizeof(magicints) / sizeof(*magicints);
+
+/*
+Open the trajectory with the registered format whose magic bytes match the start of the file. Files without a known magic
+are picked by their extension and read as .xyz text if no format claims it.
+*/
+std::shared_ptr<Reader> Reader::Open(const std::string& path) {
+    // read the leading bytes and the lowercase extension
+    char bytes[16] = {}; std::ifstream(path, std::ios::binary).read(bytes, sizeof(bytes));
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    // pick the format by the magic bytes, then by the extension
+    for (const Format& format : Formats()) {
+        if (format.probe && format.probe(std::string_view(bytes, sizeof(bytes)))) return format.open(path);
+    }
+    for (const Format& format : Formats()) {
+        if (std::find(format.extensions.begin(), format.extensions.end(), extension) != format.extensions.end()) return format.open(path);
+    }
+
+    // fall back to the text format
+    return std::make_shared<XyzReader>(path);
+}
+
+/*
+Returns the topology for the binary formats that do not store elements. The elements are read from a .gro, .pdb or .xyz file
+with the same name next to the trajectory, without one all atoms are carbons.
+*/
+std::shared_ptr<Topology> Reader::Companion(const std::string& path, size_t atoms) {
+    std::shared_ptr<Topology> topology = std::make_shared<Topology>();
+
+    // function that returns the known element of an atom name, only the element column of a pdb file has two letters
+    auto element = [](std::string_view name, bool exact) {
+        std::string symbol; for (char c : name) if (std::isalpha((unsigned char)c)) symbol += symbol.empty() ? std::toupper(c) : std::tolower(c);
+        if (exact && ptable.contains(symbol.substr(0, 2))) return symbol.substr(0, 2);
+        return ptable.contains(symbol.substr(0, 1)) ? symbol.substr(0, 1) : std::string("El");
+    };
+
+    // read the first structure of the companion file
+    for (std::string extension : { ".gro", ".pdb", ".xyz" }) {
+        std::filesystem::path companion = std::filesystem::path(path).replace_extension(extension);
+        if (!std::filesystem::exists(companion)) continue;
+        MappedFile file(companion.string()); std::string_view data = file.view(); size_t count = SIZE_MAX;
+        if (extension == ".xyz") topology = Geometry::Load(data, nullptr, 0).getTopology();
+        else for (size_t position = 0, line = 0; position < data.size() && topology->size() < count; line++) {
+            size_t next = std::min(data.find('\n', position), data.size()); std::string_view text = data.substr(position, next - position); position = next + 1;
+            if (extension == ".gro" && line == 1) {
+                size_t start = std::min(text.find_first_not_of(' '), text.size());
+                if (std::from_chars(text.data() + start, text.data() + text.size(), count).ec != std::errc()) throw std::runtime_error("Invalid atom count in " + companion.string() + ".");
+            }
+            if (extension == ".gro" && line > 1 && text.size() < 15) throw std::runtime_error("Invalid atom line in " + companion.string() + ".");
+            if (extension == ".gro" && line > 1) topology->add(element(text.substr(10, 5), false));
+            if (extension == ".pdb" && (text.starts_with("ATOM") || text.starts_with("HETATM"))) {
+                std::string_view symbol = text.size() > 76 ? text.substr(76, 2) : "";
+                topology->add(symbol.find_first_not_of(" \r") == std::string_view::npos ? element(text.substr(12, 4), false) : element(symbol, true));
+            }
+            if (extension == ".pdb" && text.starts_with("ENDMDL")) break;
+        }
+        if (topology->size() != atoms) {
+            throw std::runtime_error("The " + std::to_string(topology->size()) + " atoms in " + companion.string() + " do not match the " + std::to_string(atoms) + " atoms of the trajectory.");
+        }
+        return topology;
+    }
+
+    // use carbons without a companion file
+    for (size_t i = 0; i < atoms; i++) topology->add("C");
+    return topology;
+}
+
+/*
+Register a format, it takes precedence over the built-in ones.
+*/
+void Reader::Register(const Format& format) {
+    Formats().insert(Formats().begin(), format);
+}
+
+/*
+Returns the registered formats, the .xyz text has no magic bytes.
+*/
+std::vector<Reader::Format>& Reader::Formats() {
+    static std::vector<Format> formats = {
+        { { ".xtc" }, [](std::string_view bytes) { return Value<int32_t>(bytes.data(), std::endian::native == std::endian::little) == XTCMAGIC; }, [](const std::string& path) {
+            return std::make_shared<XtcReader>(path);
+        } },
+        { { ".dcd" }, [](std::string_view bytes) { return bytes.substr(4, 4) == "CORD" && (Value<int32_t>(bytes.data(), false) == 84 || Value<int32_t>(bytes.data(), true) == 84); }, [](const std::string& path) {
+            return std::make_shared<DcdReader>(path);
+        } },
+        { { Writer::extension }, [](std::string_view bytes) { return bytes.starts_with("LXYZ"); }, [](const std::string& path) {
+            return std::make_shared<XyzbReader>(path);
+        } },
+        { { ".xyz", ".extxyz" }, nullptr, [](const std::string& path) {
+            return std::make_shared<XyzReader>(path);
+        } }
+    };
+    return formats;
+}
+
+/*
+Map the .xyz text and find the frame offsets in a single pass.
+*/
+XyzReader::XyzReader(const std::string& path) : Reader(path) {
+    offsets = Index(file.view());
+}
+
+/*
+Find the byte offsets of the frames in an xyz file. The atom count on the first line of every frame is used to skip to the
+next one, so the frames can have different sizes. The last element is the end of the last complete frame.
+*/
+std::vector<size_t> XyzReader::Index(std::string_view data) {
+    std::vector<size_t> offsets; size_t position = 0;
+
+    // Define the function that returns the start of the next line.
+    auto line = [&data](size_t position) {
+        const char* next = (const char*)std::memchr(data.data() + position, '\n', data.size() - position);
+        return next ? next - data.data() + 1 : data.size();
+    };
+
+    // Skip over the frames.
+    while (position < data.size()) {
+        size_t begin = position, count = 0; position = line(position);
+
+        // Skip blank lines and read the atom count.
+        std::string_view header = data.substr(begin, position - begin);
+        if (header.find_first_not_of(" \t\r\n") == std::string_view::npos) continue;
+        header.remove_prefix(header.find_first_not_of(" \t"));
+        if (std::from_chars(header.data(), header.data() + header.size(), count).ec != std::errc()) {
+            throw std::runtime_error("Invalid atom count in the .xyz file.");
+        }
+
+        // Skip the comment and atom lines, stop on an incomplete frame.
+        for (size_t i = 0; i < count + 1; i++) {
+            if (position == data.size()) return offsets.push_back(begin), offsets;
+            position = line(position);
+        }
+        offsets.push_back(begin);
+    }
+
+    // Add the end of the last frame and return the offsets.
+    return offsets.push_back(position), offsets;
+}
+
+/*
+Returns the parsed text of the frame, the topology of the hint is shared if the elements match.
+*/
+Geometry XyzReader::getGeom(size_t frame, const std::shared_ptr<Topology>& hint, float factor) const {
+    return Geometry::Load(file.view().substr(offsets.at(frame), offsets.at(frame + 1) - offsets.at(frame)), hint, factor);
+}
+
+/*
+Map the binary export and read its header, element symbols and atom ids. The frames are the position arrays that follow,
+an incomplete last frame is ignored.
+*/
+XyzbReader::XyzbReader(const std::string& path) : Reader(path) {
+    const char* data = file.data(); size_t header = 32;
+    if (file.size() < header || Value<uint32_t>(data + 4, false) != Writer::version) throw std::runtime_error("Unsupported binary file " + path + ".");
+
+    // read the counts and build the topology
+    uint64_t frames = Value<uint64_t>(data + 8, false), atoms = Value<uint64_t>(data + 16, false), symbols = Value<uint64_t>(data + 24, false);
+    size_t start = header + 4 * symbols + 2 * atoms; start += (4 - start % 4) % 4; topology = std::make_shared<Topology>();
+    if (start > file.size()) throw std::runtime_error("Invalid header in " + path + ".");
+    for (size_t i = 0; i < atoms; i++) {
+        uint16_t id = Value<uint16_t>(data + header + 4 * symbols + 2 * i, false);
+        if (id >= symbols) throw std::runtime_error("Invalid element in " + path + ".");
+        topology->add(std::string_view(data + header + 4 * id, strnlen(data + header + 4 * id, 4)));
+    }
+
+    // add the offsets of the complete frames
+    for (size_t i = 0; i <= frames && start + i * atoms * sizeof(glm::vec3) <= file.size(); i++) offsets.push_back(start + i * atoms * sizeof(glm::vec3));
+}
+
+/*
+Returns the frame with the positions copied from the mapped file.
+*/
+Geometry XyzbReader::getGeom(size_t frame, const std::shared_ptr<Topology>&, float factor) const {
+    const glm::vec3* positions = (const glm::vec3*)(file.data() + offsets.at(frame));
+    Geometry geom(topology, { positions, positions + topology->size() }, {}); geom.rebind(factor);
+    return geom;
+}
+
+/*
+Map the .xtc file and find the frame offsets from the frame headers, the compressed frames store their byte count so no
+coordinates are decoded. An incomplete last frame is ignored.
+*/
+XtcReader::XtcReader(const std::string& path) : Reader(path) {
+    const char* data = file.data(); bool swap = std::endian::native == std::endian::little; size_t position = 0;
+
+    // skip over the frames
+    while (position + 56 <= file.size()) {
+        if (Value<int32_t>(data + position, swap) != XTCMAGIC || Value<int32_t>(data + position + 4, swap) <= 0) throw std::runtime_error("Invalid frame header in " + path + ".");
+        size_t count = Value<int32_t>(data + position + 4, swap), length = 56 + 3 * sizeof(float) * count;
+        if (!offsets.empty() && count != atoms) throw std::runtime_error("The frames in " + path + " have different atom counts.");
+
+        // the byte count is padded to whole words in 64 bits so that a corrupt count cannot wrap around
+        if (atoms = count; count > 9) {
+            if (position + 92 > file.size()) break;
+            length = 92 + ((size_t)Value<uint32_t>(data + position + 88, swap) + 3) / 4 * 4;
+        }
+        if (length > file.size() - position) break;
+        offsets.push_back(position), position += length;
+    }
+
+    // add the end of the last frame and read the topology
+    if (!offsets.empty()) offsets.push_back(position);
+    topology = Companion(path, atoms);
+}
+
+/*
+Returns the decoded frame in angstroms. The cell is stored as three float vectors and up to nine atoms as plain floats,
+larger frames as integers on the precision grid. An integer triple is packed into the bits of the product of the ranges
+of its components. A flag bit tells if the length of the following run of atoms, which are stored as small differences
+to their predecessor, changes and the 5 bits of the new length also adapt the size of the differences. The first two
+atoms of a run are swapped.
+*/
+Geometry XtcReader::getGeom(size_t frame, const std::shared_ptr<Topology>&, float factor) const {
+    const char* data = file.data() + offsets.at(frame); bool swap = std::endian::native == std::endian::little;
+    auto integer = [&](size_t offset) { return Value<int32_t>(data + offset, swap); };
+    auto real = [&](size_t offset) { return Value<float>(data + offset, swap); };
+    std::vector<glm::vec3> positions(atoms); glm::mat3 cell;
+
+    // read the cell and the uncompressed positions from nanometers
+    for (int i = 0; i < 9; i++) cell[i / 3][i % 3] = 10 * real(16 + 4 * i);
+    if (integer(52) != (int)atoms) throw std::runtime_error("Invalid atom count in the .xtc file.");
+    for (size_t i = 0; atoms <= 9 && i < 3 * atoms; i++) positions.at(i / 3)[i % 3] = 10 * real(56 + 4 * i);
+
+    // read the ranges of the compressed integers, components with large ranges are stored separately
+    if (atoms > 9) {
+        float scale = 10 / real(56); int minint[3], previous[3], current[3], smallidx = integer(84), bitsize = 0;
+        unsigned int sizeint[3], bitsizeint[3], sizesmall[3]; Bits bits = { (const unsigned char*)data + 92, (size_t)integer(88) };
+        for (int k = 0; k < 3; k++) minint[k] = integer(60 + 4 * k), sizeint[k] = integer(72 + 4 * k) - minint[k] + 1, bitsizeint[k] = std::bit_width(sizeint[k]);
+        if ((sizeint[0] | sizeint[1] | sizeint[2]) <= 0xffffff) bitsize = Bitsize(sizeint);
+        if (smallidx < FIRSTIDX || smallidx >= LASTIDX) throw std::runtime_error("Invalid compressed coordinates in the .xtc file.");
+        int smaller = magicints[std::max(FIRSTIDX, smallidx - 1)] / 2, smallnum = magicints[smallidx] / 2, run = 0;
+
+        // decode the atoms
+        for (size_t i = 0; i < atoms;) {
+            if (bitsize) bits.receive(bitsize, sizeint, current);
+            else for (int k = 0; k < 3; k++) current[k] = bits.receive(bitsizeint[k]);
+            for (int k = 0; k < 3; k++) current[k] += minint[k], previous[k] = current[k];
+
+            // read the run and the change of the difference size, without the flag the previous run is repeated
+            int change = 0;
+            if (bits.receive(1)) run = bits.receive(5), change = run % 3 - 1, run -= run % 3;
+            if (i + 1 + run / 3 > atoms) throw std::runtime_error("Invalid compressed coordinates in the .xtc file.");
+
+            // add the atom or the run of small differences
+            for (int j = 0; j < run; j += 3) {
+                sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx], bits.receive(smallidx, sizesmall, current);
+                for (int k = 0; k < 3; k++) current[k] += previous[k] - smallnum;
+                if (j == 0) {
+                    std::swap(current, previous), positions.at(i++) = glm::vec3(previous[0], previous[1], previous[2]) * scale;
+                } else std::copy(current, current + 3, previous);
+                positions.at(i++) = glm::vec3(current[0], current[1], current[2]) * scale;
+            }
+            if (!run) positions.at(i++) = glm::vec3(current[0], current[1], current[2]) * scale;
+
+            // adapt the size of the differences
+            if (smallidx += change; smallidx < FIRSTIDX || smallidx >= LASTIDX) throw std::runtime_error("Invalid compressed coordinates in the .xtc file.");
+            if (change < 0) smallnum = smaller, smaller = smallidx > FIRSTIDX ? magicints[smallidx - 1] / 2 : 0;
+            else if (change > 0) smaller = smallnum, smallnum = magicints[smallidx] / 2;
+        }
+    }
+
+    // create the geometry
+    Geometry geom(topology, std::move(positions), {}); geom.setCell(cell), geom.rebind(factor);
+    return geom;
+}
+
+/*
+Returns the number of bits needed for the product of the three sizes, which can exceed 64 bits, so it is multiplied in bytes.
+*/
+int XtcReader::Bitsize(const unsigned int sizes[3]) {
+    unsigned int bytes[16] = { 1 }, count = 1;
+    for (int i = 0; i < 3; i++) {
+        unsigned int carry = 0, j = 0;
+        for (; j < count; j++) carry += bytes[j] * sizes[i], bytes[j] = carry & 0xff, carry >>= 8;
+        for (; carry; carry >>= 8) bytes[j++] = carry & 0xff;
+        count = j;
+    }
+    return std::bit_width(bytes[count - 1]) + 8 * (count - 1);
+}
+
+/*
+Returns the next bits of the stream as an unsigned integer, the bits are read from the most significant one.
+*/
+unsigned int XtcReader::Bits::receive(int bits) {
+    unsigned int mask = bits < 32 ? (1u << bits) - 1 : ~0u, number = 0;
+    auto next = [this]() {
+        if (count == size) throw std::runtime_error("Invalid compressed coordinates in the .xtc file.");
+        return data[count++];
+    };
+    for (; bits >= 8; bits -= 8) lastbyte = (lastbyte << 8) | next(), number |= (lastbyte >> lastbits) << (bits - 8);
+    if (bits > 0) {
+        if ((int)lastbits < bits) lastbits += 8, lastbyte = (lastbyte << 8) | next();
+        lastbits -= bits, number |= (lastbyte >> lastbits) & ((1u << bits) - 1);
+    }
+    return number & mask;
+}
+
+/*
+Read three integers packed into the bits as one number in the mixed radix of their sizes. The number is read in little
+endian bytes and divided by the sizes from the last one.
+*/
+void XtcReader::Bits::receive(int bits, const unsigned int sizes[3], int numbers[3]) {
+    unsigned int bytes[16] = {}; int count = 0;
+    for (; bits > 8; bits -= 8) bytes[count++] = receive(8);
+    if (bits > 0) bytes[count++] = receive(bits);
+    for (int i = 2; i > 0; i--) {
+        unsigned int number = 0;
+        for (int j = count - 1; j >= 0; j--) number = (number << 8) | bytes[j], bytes[j] = number / sizes[i], number -= bytes[j] * sizes[i];
+        numbers[i] = number;
+    }
+    numbers[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+}
+
+/*
+Map the .dcd file and read the header records, the byte order follows the first record marker. The frames have a fixed
+size after the header, so their offsets are computed. Fixed atoms, whose first frame differs, are not supported.
+*/
+DcdReader::DcdReader(const std::string& path) : Reader(path) {
+    const char* data = file.data(); swap = file.size() >= 4 && Value<int32_t>(data, false) != 84;
+    auto integer = [&](size_t offset) {
+        if (offset + 4 > file.size()) throw std::runtime_error("Invalid header in " + path + ".");
+        return Value<int32_t>(data + offset, swap);
+    };
+
+    // read the control block, a charmm file can add a unit cell and a fourth dimension to the frames
+    if (integer(0) != 84 || file.view().substr(4, 4) != "CORD") throw std::runtime_error("Invalid header in " + path + ".");
+    bool charmm = integer(84), four = charmm && integer(52); unitcell = charmm && integer(48);
+    if (integer(40)) throw std::runtime_error("The fixed atoms in " + path + " are not supported.");
+
+    // skip the title record and read the atom count
+    if (integer(92) < 0) throw std::runtime_error("Invalid header in " + path + ".");
+    size_t position = 92 + integer(92) + 8;
+    if (integer(position) != 4 || integer(position + 4) <= 0) throw std::runtime_error("Invalid header in " + path + ".");
+    atoms = integer(position + 4), position += 12;
+
+    // add the offsets of the complete frames and read the topology
+    size_t length = (unitcell ? 56 : 0) + (four ? 4 : 3) * (8 + 4 * atoms);
+    for (; position + length <= file.size(); position += length) offsets.push_back(position);
+    if (!offsets.empty()) offsets.push_back(position);
+    topology = Companion(path, atoms);
+}
+
+/*
+Returns the frame read from the coordinate records. The unit cell is stored as the lengths and angles a, gamma, b, beta,
+alpha, c, where newer writers store the cosines of the angles instead of degrees.
+*/
+Geometry DcdReader::getGeom(size_t frame, const std::shared_ptr<Topology>&, float factor) const {
+    const char* data = file.data() + offsets.at(frame); std::vector<glm::vec3> positions(atoms); glm::mat3 cell(0);
+
+    // build the cell vectors from the lengths and angles
+    if (unitcell) {
+        double box[6]; for (int i = 0; i < 6; i++) box[i] = Value<double>(data + 4 + 8 * i, swap);
+        bool cosines = std::abs(box[1]) <= 1 && std::abs(box[3]) <= 1 && std::abs(box[4]) <= 1;
+        double alpha = cosines ? box[4] : std::cos(glm::radians(box[4])), beta = cosines ? box[3] : std::cos(glm::radians(box[3]));
+        double gamma = cosines ? box[1] : std::cos(glm::radians(box[1])), sine = std::sqrt(1 - gamma * gamma), z = (alpha - beta * gamma) / sine;
+        if (box[0] > 0 && box[2] > 0 && box[5] > 0 && sine > 0) {
+            cell[0] = glm::vec3(box[0], 0, 0), cell[1] = glm::vec3(box[2] * gamma, box[2] * sine, 0);
+            cell[2] = glm::vec3(box[5] * beta, box[5] * z, box[5] * std::sqrt(std::max(0.0, 1 - beta * beta - z * z)));
+        }
+        data += 56;
+    }
+
+    // read the x, y and z records
+    for (int k = 0; k < 3; k++) {
+        const char* record = data + k * (8 + 4 * atoms);
+        if (Value<int32_t>(record, swap) != 4 * (int)atoms) throw std::runtime_error("Invalid coordinate record in the .dcd file.");
+        for (size_t i = 0; i < atoms; i++) positions.at(i)[k] = Value<float>(record + 4 + 4 * i, swap);
+    }
+
+    // create the geometry
+    Geometry geom(topology, std::move(positions), {}); geom.setCell(cell), geom.rebind(factor);
+    return geom;
+}
@@ -12,6 +12,16 @@ Shader::Shader(const std::string& vertex, const std::string& fragment) : id(glCr
     glLinkProgram(id), glValidateProgram(id);
     glDetachShader(id, vs), glDetachShader(id, fs);
     glDeleteShader(vs), glDeleteShader(fs), use();
+
+    // resolve the locations of all active default block uniforms once, array uniforms are reported as "name[0]"
+    int count, length; glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count), glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &length);
+    for (int i = 0, size; i < count; i++) {
+        std::vector<char> name(length + 1); GLenum type; glGetActiveUniform(id, i, length + 1, nullptr, &size, &type, name.data());
+        if (int location = glGetUniformLocation(id, name.data()); location >= 0) {
+            std::string key = name.data(); uniforms[key] = location;
+            if (key.size() > 3 && key.ends_with("[0]")) uniforms[key.substr(0, key.size() - 3)] = location;
+        }
+    }
 }
 
 Shader::~Shader() {
@@ -28,21 +38,27 @@ void Shader::errorCheck(unsigned int shader, const std::string& title) const {
     }
 }
 
+int Shader::locate(const std::string& name) const {
+    auto it = uniforms.find(name); return it != uniforms.end() ? it->second : -1;
+}
+
 void Shader::use() const {
     glUseProgram(id);
 }
 
 template <typename T>
 void Shader::set(const std::string& name, T value) const {
-    if constexpr (std::is_same<T, int>()) glUniform1i(glGetUniformLocation(id, name.c_str()), value);
-    if constexpr (std::is_same<T, float>()) glUniform1f(glGetUniformLocation(id, name.c_str()), value);
-    if constexpr (std::is_same<T, glm::vec3>()) glUniform3f(glGetUniformLocation(id, name.c_str()), value[0], value[1], value[2]);
-    if constexpr (std::is_same<T, glm::vec4>()) glUniform4f(glGetUniformLocation(id, name.c_str()), value[0], value[1], value[2], value[3]);
-    if constexpr (std::is_same<T, glm::mat4>()) glUniformMatrix4fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, &value[0][0]);
+    if constexpr (std::is_same<T, int>()) glUniform1i(locate(name), value);
+    if constexpr (std::is_same<T, float>()) glUniform1f(locate(name), value);
+    if constexpr (std::is_same<T, glm::vec3>()) glUniform3f(locate(name), value[0], value[1], value[2]);
+    if constexpr (std::is_same<T, glm::vec4>()) glUniform4f(locate(name), value[0], value[1], value[2], value[3]);
+    if constexpr (std::is_same<T, glm::mat3>()) glUniformMatrix3fv(locate(name), 1, GL_FALSE, &value[0][0]);
+    if constexpr (std::is_same<T, glm::mat4>()) glUniformMatrix4fv(locate(name), 1, GL_FALSE, &value[0][0]);
 }
 
 template void Shader::set<float>(const std::string& name, float value) const;
 template void Shader::set<glm::vec3>(const std::string& name, glm::vec3 value) const;
 template void Shader::set<glm::vec4>(const std::string& name, glm::vec4 value) const;
+template void Shader::set<glm::mat3>(const std::string& name, glm::mat3 value) const;
 template void Shader::set<glm::mat4>(const std::string& name, glm::mat4 value) const;
 template void Shader::set<int>(const std::string& name, int value) const;
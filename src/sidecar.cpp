@@ -0,0 +1,108 @@
+#include "sidecar.h"
+
+/*
+Open the binary sidecar of the source file. Returns nullptr if there is none, if it does not match the current size and
+modification time of the source, the format version or the default binding factor, or if its ids or frame index point
+outside of the file, so a corrupt sidecar falls back to the source.
+*/
+std::shared_ptr<Sidecar> Sidecar::Open(const std::string& source) {
+    // Check that the sidecar exists and map it
+    if (!std::filesystem::exists(source + extension)) return nullptr;
+    std::shared_ptr<Sidecar> sidecar = std::make_shared<Sidecar>(source + extension);
+
+    // Validate the header against the source file
+    Header stamp = Stamp(source); const Header* header = (const Header*)sidecar->file.data();
+    if (sidecar->file.size() < sizeof(Header) || std::memcmp(header->magic, stamp.magic, 4) || header->version != version) return nullptr;
+    if (header->size != stamp.size || header->time != stamp.time || header->factor != stamp.factor) return nullptr;
+
+    // Validate the extents of the symbols, the ids and the frame index, the counts are bounded first so the sums cannot overflow
+    size_t size = sidecar->file.size(), records = sizeof(Header) + 4 * header->symbols + 2 * header->atoms;
+    if (header->symbols > size / 4 || header->atoms > size / 2 || !header->frames || header->frames >= size / 8) return nullptr;
+    if (header->index % 8 || records > header->index || header->index > size - (header->frames + 1) * sizeof(uint64_t)) return nullptr;
+
+    // Assign the header and the frame index
+    sidecar->header = header, sidecar->index = (const uint64_t*)(sidecar->file.data() + header->index);
+
+    // Validate the frame records, each holds the cell, the positions and whole bonds
+    for (size_t i = 0, minimum = sizeof(glm::mat3) + header->atoms * sizeof(glm::vec3); i < header->frames; i++) {
+        uint64_t start = sidecar->index[i], end = sidecar->index[i + 1];
+        if (start < records || start % 4 || end < start || end > header->index || end - start < minimum || (end - start - minimum) % sizeof(glm::uvec2)) return nullptr;
+    }
+
+    // Build the topology from the element symbols and ids
+    const char* symbols = sidecar->file.data() + sizeof(Header); sidecar->topology = std::make_shared<Topology>();
+    const uint16_t* ids = (const uint16_t*)(symbols + 4 * header->symbols);
+    for (size_t i = 0; i < header->atoms; i++) {
+        if (ids[i] >= header->symbols) return nullptr;
+        sidecar->topology->add(std::string_view(symbols + 4 * ids[i], strnlen(symbols + 4 * ids[i], 4)));
+    }
+
+    // Return the sidecar
+    return sidecar;
+}
+
+/*
+Returns the header with the magic, version, size and modification time of the source file and the default binding factor.
+*/
+Sidecar::Header Sidecar::Stamp(const std::string& source) {
+    Header header = { { 'L', 'U', 'I', 'S' }, version, std::filesystem::file_size(source), 0, 0, 0, 0, 0, BINDINGFACTOR };
+    header.time = std::filesystem::last_write_time(source).time_since_epoch().count();
+    return header;
+}
+
+/*
+Returns the frame with cell, positions and bonds copied from the mapped file.
+*/
+Geometry Sidecar::getGeom(size_t frame) const {
+    const glm::mat3* cell = (const glm::mat3*)(file.data() + index[frame]); const glm::vec3* positions = (const glm::vec3*)(cell + 1);
+    const glm::uvec2* bonds = (const glm::uvec2*)(positions + header->atoms), *end = (const glm::uvec2*)(file.data() + index[frame + 1]);
+    Geometry geom(topology, { positions, positions + header->atoms }, { bonds, end }); geom.setCell(*cell);
+    return geom;
+}
+
+/*
+Write the frames into the binary sidecar of the source file. The layout is the header, the element symbols, the element ids
+of the atoms, one record of cell, positions and bonds per frame and the index of the frame records. The file is written under a
+temporary name and renamed at the end, it is not written at all if the frames do not share one topology, the writing fails
+or the stop is requested.
+*/
+void Sidecar::Write(const std::string& source, size_t frames, const std::function<std::shared_ptr<const Geometry>(size_t)>& frame, std::stop_token stop) {
+    std::string path = source + extension, temporary = path + ".tmp"; Profiler::Scope scope("Sidecar");
+    try {
+        // Open the temporary file and get the topology of the first frame
+        std::ofstream file(temporary, std::ios::binary); std::shared_ptr<const Geometry> geom = frame(0);
+        std::shared_ptr<Topology> topology = geom->getTopology(); Header header = Stamp(source);
+        header.frames = frames, header.atoms = topology->size(), header.symbols = topology->symbols.size();
+
+        // Write the header placeholder, element symbols and ids
+        file.write((const char*)&header, sizeof(Header));
+        for (const std::string& symbol : topology->symbols) {
+            char name[4] = {}; symbol.copy(name, 4); file.write(name, 4);
+        }
+        for (unsigned short id : topology->ids) {
+            uint16_t value = id; file.write((const char*)&value, sizeof(uint16_t));
+        }
+        file.write("\0\0\0", (4 - file.tellp() % 4) % 4);
+
+        // Write the frame records and remember their offsets
+        std::vector<uint64_t> index;
+        for (size_t i = 0; i < frames; i++) {
+            if (stop.stop_requested() || (i && (geom = frame(i))->getTopology() != topology)) throw std::runtime_error("");
+            index.push_back(file.tellp()), file.write((const char*)&geom->getCell(), sizeof(glm::mat3));
+            file.write((const char*)geom->getPositions().data(), geom->getPositions().size() * sizeof(glm::vec3));
+            file.write((const char*)geom->getBonds().data(), geom->getBonds().size() * sizeof(glm::uvec2));
+        }
+        index.push_back(file.tellp());
+
+        // Write the aligned frame index and the final header
+        file.write("\0\0\0\0\0\0\0", (8 - file.tellp() % 8) % 8), header.index = file.tellp();
+        file.write((const char*)index.data(), index.size() * sizeof(uint64_t));
+        file.seekp(0), file.write((const char*)&header, sizeof(Header));
+
+        // Close the file and move it in place
+        if (file.close(); !file) throw std::runtime_error("");
+        std::filesystem::rename(temporary, path);
+    } catch (...) {
+        std::error_code error; std::filesystem::remove(temporary, error);
+    }
+}
@@ -0,0 +1,14 @@
+#include "topology.h"
+
+/*
+Append an atom with the provided element symbol and return its element id. New elements get the sphere radius from the
+periodic table, the atom size factor is applied when rendering.
+*/
+unsigned short Topology::add(std::string_view symbol) {
+    unsigned short id = std::find(symbols.begin(), symbols.end(), symbol) - symbols.begin();
+    if (id == symbols.size()) {
+        symbols.emplace_back(symbol), radii.push_back(ptable.at(std::string(symbol)).radius);
+    }
+    return ids.push_back(id), id;
+}
+
@@ -1,65 +1,403 @@
 #include "trajectory.h"
 
 /*
-Function that loads an xyz file with molecular trajectory.
+Function that loads a molecular trajectory in any format of the reader registry. An up to date binary sidecar of the file is
+mapped instead of the text if it exists. Otherwise the file is mapped into memory by its reader, which finds the frame offsets
+in a single pass, and the sidecar of a text file is written for the next time. If all frames fit into the memory budget (in bytes) they are decoded in parallel,
+otherwise the frames are decoded on demand through a frame cache. With a precision (in Angstrom) the cache decodes them from
+a compressed store in memory instead of the file, if the store fits into half of the budget. Resident frames are copied out
+of the mapping, because the alignment and the rebinding change them in place, and the mapping is released after the copy.
 */
-Trajectory Trajectory::Load(const std::string& filename) {
+Trajectory Trajectory::Load(const std::string& filename, size_t memory, float precision) {
 
-    // Create the graphiv trajectory object
-    Trajectory trajectory;
+    // Create the graphic trajectory object and start the timer.
+    Trajectory trajectory; auto start = std::chrono::high_resolution_clock().now(); Profiler::Scope scope("Load");
 
-    // Open a file and create buffer
-    std::ifstream file(filename); std::string line;
-    std::getline(file, line);
-
-    // Get the atom count (length) and file length (block).
-    int length = std::stoi(line), block = 1;
-    while (std::getline(file, line)) block++;
+    // Open the sidecar or the reader of the file format.
+    if (Profiler::Scope index("Index"); !(trajectory.sidecar = Sidecar::Open(filename))) {
+        if (trajectory.source = Reader::Open(filename); !trajectory.source->size()) throw std::runtime_error("No geometry found in " + filename + ".");
+    }
 
-    // Create the vector of geometris and reset the file reader.
-    trajectory.geoms.resize(block / (length + 2));
-    file.clear(), file.seekg(0);
+    // Read the first geometry, its topology is shared with the rest.
+    Geometry first = trajectory.sidecar ? trajectory.sidecar->getGeom(0) : trajectory.source->getGeom(0, nullptr, trajectory.factor);
+    trajectory.frames = trajectory.sidecar ? trajectory.sidecar->size() : trajectory.source->size();
+    trajectory.topology = first.getTopology(); std::function<Geometry(size_t)> raw = trajectory.decoder();
+    trajectory.transform = glm::translate(glm::mat4(1), -first.getCenter());
 
-    // Read the individual geometries.
-    for (int i = 0; i < block / (length + 2); i++) {
-        std::stringstream ss;
+    // Stream the frames if they do not fit into the memory budget, the rest of the budget caches the frames of the store.
+    if (first.getMemory() * trajectory.frames > memory) {
+        if (precision > 0) trajectory.store = Compress(trajectory.frames, trajectory.topology, precision, memory / 2, trajectory.decoder(false));
+        if (trajectory.store) trajectory.compression = (double)first.getMemory() * trajectory.frames / trajectory.store->getBytes();
+        trajectory.cache = std::make_unique<FrameCache>(trajectory.decoder(), trajectory.frames, memory - (trajectory.store ? trajectory.store->getBytes() : 0));
+        trajectory.current = std::make_shared<const Geometry>(std::move(first));
+    }
 
-        // For lines in one geometry.
-        for (int j = 0; j < length + 2; j++) {
-            std::getline(file, line); ss << (j ? "\n" : "" ) << line;
-        }
+    // Otherwise decode contiguous ranges of the geometries on all threads, so the bonding reuses the candidate pairs.
+    else {
+        trajectory.geoms.resize(trajectory.frames), trajectory.geoms.at(0) = std::move(first);
+        size_t nthread = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), trajectory.frames);
+        std::atomic<bool> failed = false; std::exception_ptr error;
+        std::vector<std::thread> threads; std::mutex mutex;
+        for (size_t i = 0; i < nthread; i++) threads.emplace_back([&, i]() {
+            try {
+                Profiler::Scope scope("Decode");
+                for (size_t j = std::max<size_t>(i * trajectory.frames / nthread, 1); j < (i + 1) * trajectory.frames / nthread && !failed; j++) {
+                    trajectory.geoms.at(j) = raw(j);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex); error = std::current_exception(), failed = true;
+            }
+        });
+        for (std::thread& thread : threads) thread.join();
+        if (error) std::rethrow_exception(error);
 
-        // Load a geometry to a molecule class.
-        trajectory.geoms.at(i) = Geometry::Load(ss);
+        trajectory.current = trajectory.getGeom(0);
     }
 
-    // Set the initialization timestamp (for FPS manipulation).
+    // Set the initialization timestamp (for FPS manipulation) and the loading throughput.
     trajectory.timestamp = std::chrono::high_resolution_clock().now();
+    size_t bytes = trajectory.sidecar ? trajectory.sidecar->getBytes() : trajectory.source->getBytes();
+    trajectory.throughput = bytes / 1e6 / std::chrono::duration<double>(trajectory.timestamp - start).count();
 
-    // Center the trajectory
-    trajectory.moveBy(-trajectory.geoms.at(0).getCenter());
+    // Write the sidecar of a text file in the background, resident frames are read in place and the writing is canceled before
+    // they are changed, streamed frames are decoded again.
+    if (!trajectory.sidecar && trajectory.source->isText()) {
+        std::function<std::shared_ptr<const Geometry>(size_t)> frame = trajectory.reader();
+        if (trajectory.cache) frame = [raw](size_t i) { return std::make_shared<const Geometry>(raw(i)); };
+        trajectory.writer = std::jthread([filename, frames = trajectory.frames, frame](std::stop_token stop) { Sidecar::Write(filename, frames, frame, stop); });
+    }
+
+    // Release the mapping of the resident frames, only streamed frames are decoded again.
+    if (!trajectory.cache) trajectory.sidecar = nullptr, trajectory.source = nullptr;
 
     // Return the trajectory
     return trajectory;
 }
 
 /*
-Move the trajectory by some vector.
+Encode all frames into a compressed store on all threads, one keyframe group at a time. Returns nullptr if the store exceeds
+the budget in bytes or cannot hold the frames, they are streamed from the file then.
+*/
+std::shared_ptr<const FrameStore> Trajectory::Compress(size_t frames, const std::shared_ptr<Topology>& topology, float precision, size_t budget, const std::function<Geometry(size_t)>& decode) {
+    std::shared_ptr<FrameStore> store = std::make_shared<FrameStore>(frames, topology, precision); Profiler::Scope scope("Compress");
+    size_t groups = (frames + STOREKEYFRAME - 1) / STOREKEYFRAME; std::atomic<size_t> next = 0; std::atomic<bool> failed = false;
+    std::vector<std::thread> threads; std::exception_ptr error; std::mutex mutex;
+    for (size_t i = 0; i < std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), groups); i++) threads.emplace_back([&]() {
+        try {
+            for (size_t group = next++; group < groups && !failed; group = next++) if (!store->encode(group, decode) || store->getBytes() > budget) failed = true;
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex); error = std::current_exception(), failed = true;
+        }
+    });
+    for (std::thread& thread : threads) thread.join();
+    if (error) std::rethrow_exception(error);
+    return failed ? nullptr : store;
+}
+
+/*
+Returns the function that decodes a frame with the current binding factor, or without bonds, and applies its alignment and
+the cell set for all frames, which is given after the alignment and needs the frame to be bonded again. Frames of the store
+are always bonded after the alignment. It keeps the store, the reader or the sidecar alive and does not reference the
+trajectory, so it can run on the prefetch thread.
+*/
+std::function<Geometry(size_t)> Trajectory::decoder(bool bonds) const {
+    return [store = store, source = source, sidecar = sidecar, topology = topology, alignments = alignments, cell = cell, factor = bonds ? factor : 0](size_t frame) {
+        Geometry geom;
+        if (store) geom = store->getGeom(frame);
+        else if (sidecar) {
+            geom = sidecar->getGeom(frame); if (factor && factor != sidecar->getFactor() && !cell) geom.rebind(factor);
+        } else geom = source->getGeom(frame, topology, cell ? 0 : factor);
+        if (alignments) geom.transformBy(alignments->at(frame));
+        if (cell) geom.setCell(*cell);
+        if (cell || store) geom.rebind(factor);
+        return geom;
+    };
+}
+
+/*
+Returns the requested frame. Streamed frames that are not cached are decoded on the calling thread.
+*/
+std::shared_ptr<const Geometry> Trajectory::getGeom(int frame) {
+    if (cache) return cache->get(frame);
+    return std::shared_ptr<const Geometry>(std::shared_ptr<const Geometry>(), &geoms.at(frame));
+}
+
+/*
+Stop the rebinding worker, the sidecar writer, the export and the analysis before the frames are destroyed.
+*/
+Trajectory::~Trajectory() {
+    if (worker.joinable()) worker.request_stop(), worker.join();
+    if (writer.joinable()) writer.request_stop(), writer.join();
+    exporter = nullptr, analysis = nullptr;
+}
+
+/*
+Apply the bonds found by the rebinding worker since the last call. Only the render thread changes the frames. The uploaded
+chunk keeps its bonds until the worker is done and is uploaded once again then, so the rebinding does not upload the chunk
+on every frame.
+*/
+void Trajectory::collect() {
+    if (!job) return;
+    bool finished; {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        for (auto& [frame, bonds] : job->results) geoms.at(frame).setBonds(std::move(bonds));
+        job->results.clear(), finished = job->done == job->total;
+    }
+    if (finished && texture) texture->reset();
+    if (finished) job = nullptr;
+}
+
+/*
+Wait for the rebinding worker and apply all of its bonds, then wait for the export and rethrow its error.
+*/
+void Trajectory::finish() {
+    if (worker.joinable()) worker.join();
+    if (collect(); exporter) exporter->wait();
+}
+
+/*
+Returns the spatial index of the current frame. The hierarchy is refitted when the frame, the atom size or the wrapping
+changes and rebuilt for different atoms or after BVHREFITS refits, so the bounds stay tight while the atoms drift. Wrapped
+atoms are indexed where they are rendered.
+*/
+const Bvh& Trajectory::index() {
+    if (indexed == current && indexedSize == atomSizeFactor && indexedWrap == wrap) return bvh;
+    const std::shared_ptr<Topology>& topology = current->getTopology(); std::vector<float> radii(current->size());
+    for (size_t i = 0; i < radii.size(); i++) radii.at(i) = atomSizeFactor * topology->radii.at(topology->ids.at(i));
+
+    // wrap the positions into the periodic cell
+    const glm::mat3& cell = current->getCell(); std::vector<glm::vec3> wrapped;
+    if (wrap && Neighbor::Periodic(cell)) {
+        glm::mat3 fraction = glm::inverse(cell);
+        for (const glm::vec3& position : current->getPositions()) wrapped.push_back(Neighbor::Wrap(position, cell, fraction));
+    }
+    const std::vector<glm::vec3>& positions = wrapped.empty() ? current->getPositions() : wrapped;
+
+    // refit or rebuild the hierarchy
+    if (indexed && indexed->getTopology() == topology && refits++ < BVHREFITS) bvh.refit(positions, radii);
+    else bvh = Bvh(positions, radii), refits = 0;
+    return indexed = current, indexedSize = atomSizeFactor, indexedWrap = wrap, bvh;
+}
+
+/*
+Returns the atom of the current frame that is hit first by the ray in the world coordinates, or -1 if it misses all atoms.
+*/
+int Trajectory::pick(const glm::vec3& origin, const glm::vec3& direction) {
+    if (!frames) return -1;
+    glm::mat4 inverse = glm::inverse(transform);
+    return index().intersect(glm::vec3(inverse * glm::vec4(origin, 1)), glm::vec3(inverse * glm::vec4(direction, 0)));
+}
+
+/*
+Returns the atoms of the current frame within the radius of the point in the world coordinates.
+*/
+std::vector<unsigned int> Trajectory::query(const glm::vec3& center, float radius) {
+    if (!frames) return {};
+    return index().query(glm::vec3(glm::inverse(transform) * glm::vec4(center, 1)), radius / glm::length(glm::vec3(transform[0])));
+}
+
+/*
+Move the center of the current frame to the origin.
+*/
+void Trajectory::center() {
+    if (frames) moveBy(-glm::vec3(transform * glm::vec4(current->getCenter(), 1)));
+}
+
+/*
+Move the trajectory by some vector. Only the transform of the trajectory is changed, the frames are untouched.
 */
 void Trajectory::moveBy(const glm::vec3& vector) {
-    for (Geometry& geom : geoms) geom.moveBy(vector);
+    transformBy(glm::translate(glm::mat4(1), vector));
+}
+
+/*
+Apply the matrix after the current transform of the trajectory. The transform is used by the shaders, so the cost does not
+depend on the number of frames.
+*/
+void Trajectory::transformBy(const glm::mat4& matrix) {
+    transform = matrix * transform;
+}
+
+/*
+Superimpose all frames onto the reference frame or the average structure by the selected atoms. The rebinding is finished
+first, a running export keeps the frames it started with. Resident positions are rewritten in place on all threads, so they
+are not aligned during their export, the alignments of streamed frames are applied by the decoder, so the rendering cost does
+not change.
+*/
+void Trajectory::align(const Alignment::Options& options) {
+    if (!cache && exporter && !exporter->isDone()) throw std::runtime_error("The frames can not be aligned during their export.");
+    if (worker.joinable()) worker.join();
+    collect(), analysis = nullptr; std::vector<glm::mat4> matrices = Alignment::Run(frames, reader(), options);
+
+    // combine the alignments of the streamed frames with the previous ones and restart the cache
+    if (cache) {
+        for (size_t i = 0; alignments && i < matrices.size(); i++) matrices.at(i) = matrices.at(i) * alignments->at(i);
+        alignments = std::make_shared<const std::vector<glm::mat4>>(std::move(matrices));
+        return cache->reset(decoder()), current = cache->get(frame), void();
+    }
+
+    // cancel the sidecar writer, rewrite the resident positions and drop the uploaded ones
+    std::atomic<size_t> next = 0; std::vector<std::thread> threads; writer = std::jthread();
+    for (size_t i = 0; i < std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), frames); i++) threads.emplace_back([&]() {
+        for (size_t j = next++; j < geoms.size(); j = next++) geoms.at(j).transformBy(matrices.at(j));
+    });
+    for (std::thread& thread : threads) thread.join();
+    if (indexed = nullptr; texture) texture->reset();
+}
+
+/*
+Export the selected frames and atoms with the transform of the trajectory applied in the background, a running export is
+canceled.
+*/
+void Trajectory::save(const std::string& filename, const Writer::Selection& selection) {
+    exporter = nullptr, exporter = std::make_unique<Writer>(filename, frames, reader(), transform, selection);
+}
+
+/*
+Returns the series of the atom tuple over all frames, it is computed in the background on the first request.
+*/
+std::shared_ptr<const Analysis::Series> Trajectory::analyze(const std::vector<size_t>& atoms) {
+    if (!analysis) analysis = std::make_unique<Analysis>(frames, reader());
+    return analysis->get(atoms);
 }
 
 /*
-Renders the trajectory with the provided shader.
+Returns the function that reads the positions of a frame on a background thread. Resident frames are read in place,
+streamed frames are decoded without bonds on the calling thread, so the playback cache is not disturbed.
+*/
+std::function<std::shared_ptr<const Geometry>(size_t)> Trajectory::reader() const {
+    if (cache) return [decode = decoder(false)](size_t i) { return std::make_shared<const Geometry>(decode(i)); };
+    return [geoms = geoms.data()](size_t i) { return std::shared_ptr<const Geometry>(std::shared_ptr<const Geometry>(), geoms + i); };
+}
+
+/*
+Create the bonds of all frames with the provided binding factor. The current frame is bonded immediately, the others on a
+background worker in blocks of consecutive frames following the current one, their bonds are applied by the render calls.
+A running worker is canceled first, its remaining frames are covered by the new one.
+*/
+void Trajectory::rebind(float factor) {
+    this->factor = factor;
+    if (cache) return cache->reset(decoder()), current = cache->get(frame), void();
+
+    // cancel the previous job and the sidecar writer, drop the uploaded bonds and bond the current frame
+    worker = std::jthread(), job = nullptr, writer = std::jthread();
+    if (texture) texture->reset();
+    if (geoms.empty()) return;
+    geoms.at(frame).rebind(factor);
+    if (geoms.size() < 2) return;
+
+    // bond the rest of the frames on the worker threads
+    job = std::make_shared<Job>(), job->total = geoms.size() - 1;
+    worker = std::jthread([job = job, geoms = geoms.data(), frames = geoms.size(), start = (size_t)frame, factor](std::stop_token stop) {
+        std::atomic<size_t> next = 0; std::vector<std::thread> threads;
+        for (size_t i = 0; i < std::max(2u, std::thread::hardware_concurrency()) - 1; i++) threads.emplace_back([&]() {
+            for (size_t block = next++ * REBINDBLOCK; block < frames - 1; block = next++ * REBINDBLOCK) {
+                for (size_t j = block; j < std::min<size_t>(block + REBINDBLOCK, frames - 1) && !stop.stop_requested(); j++) {
+                    size_t index = (start + 1 + j) % frames; std::vector<glm::uvec2> bonds = geoms[index].findBonds(factor);
+                    std::lock_guard<std::mutex> lock(job->mutex); job->results.emplace_back(index, std::move(bonds)), job->done++;
+                }
+            }
+        });
+        for (std::thread& thread : threads) thread.join();
+    });
+}
+
+/*
+Renders the trajectory with the provided shader. The playback position is a continuous cursor advanced by the elapsed time,
+the wait between frames and the speed factor, the fraction between two frames is interpolated by the shader. Streamed frames
+that are not decoded yet are requested from the prefetch thread and the last available frame is rendered meanwhile. Resident
+frames are rendered from the chunk uploaded to the buffer texture, a new chunk is uploaded when the frame leaves it.
 */
 void Trajectory::render(const Shader& shader, const Shader& sshader, int highlight) {
-    if (geoms.size()) {
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock().now() - timestamp).count();
-        if (elapsed > wait) {
-            if (!paused && wait > 0) frame = (frame + (int)(elapsed / wait)) % (int)geoms.size();
-            timestamp = std::chrono::high_resolution_clock().now();
+    if (Profiler::Scope scope("Advance"); frames) {
+        collect(); auto now = std::chrono::high_resolution_clock().now();
+
+        // advance the cursor, the frame may have been changed from the gui
+        double elapsed = std::chrono::duration<double, std::milli>(now - timestamp).count(); timestamp = now;
+        if (frame != (int)cursor) cursor = frame;
+        if (!paused && wait > 0) cursor = std::fmod(cursor + speed * elapsed / wait, (double)frames);
+        frame = (int)cursor;
+
+        // render the frame from the buffer texture if the frames are resident on the GPU
+        if (resident && !cache) {
+            if (!texture) texture = std::make_unique<FrameTexture>((size_t)VIDEOMEMORY << 20);
+            if (!texture->contains(frame)) texture->load(geoms, frame);
+            current = getGeom(frame), scope.end(), setup(shader, sshader, interpolate ? cursor - frame : 0);
+            return texture->render(frame, shader, sshader, highlight, current->getCell(), wrap), renderCell(*current, shader);
         }
-        geoms.at(frame).render(shader, sshader, highlight);
+
+        // get the current frame and the next one if it is available and the frames are interpolated, a frame that fails to decode
+        // keeps the last one and its error is reported
+        std::shared_ptr<const Geometry> next; bool ready = true;
+        if (!cache) current = getGeom(frame);
+        else try {
+            if (std::shared_ptr<const Geometry> geom = cache->get(frame, false)) current = geom;
+            else ready = false;
+        } catch (const std::exception& exception) { error = exception.what(), ready = false; }
+        if (interpolate && ready && frame + 1 < frames) next = cache ? cache->peek(frame + 1) : getGeom(frame + 1);
+
+        // render the frame
+        scope.end(), render(*current, shader, sshader, highlight, next.get(), next ? cursor - frame : 0);
     }
 }
+
+/*
+Renders a frame with the transform of the trajectory, which also places the frame in the culled view. The next frame is
+blended in by the alpha factor.
+*/
+void Trajectory::render(const Geometry& geom, const Shader& shader, const Shader& sshader, int highlight, const Geometry* next, float alpha) const {
+    setup(shader, sshader, alpha), geom.render(shader, sshader, highlight, next, transform, wrap), renderCell(geom, shader);
+}
+
+/*
+Renders the edges of the periodic cell of the frame with the bond mesh, the cell spans its vectors from the origin.
+*/
+void Trajectory::renderCell(const Geometry& geom, const Shader& shader) const {
+    const glm::mat3& cell = geom.getCell(); std::vector<Instance> edges;
+    if (!outline || !Neighbor::Periodic(cell)) return;
+    for (int k = 0; k < 3; k++) for (int corner = 0; corner < 4; corner++) {
+        glm::vec3 start = (corner & 1 ? cell[(k + 1) % 3] : glm::vec3(0)) + (corner & 2 ? cell[(k + 2) % 3] : glm::vec3(0));
+        glm::mat4 model = Geometry::Cylinder(start, start + cell[k]); edges.push_back({ model, model });
+    }
+    shader.use(), shader.set<int>("u_resident", 0), Geometry::meshes.at("bond").render(shader, edges);
+}
+
+/*
+Set the transform of the trajectory and the interpolation factor of the programs. The atom size factor and the bond
+thickness are set as the model matrices of the meshes, so changing them does not touch the frames.
+*/
+void Trajectory::setup(const Shader& shader, const Shader& sshader, float alpha) const {
+    Geometry::meshes.at("atom").setModel(glm::scale(glm::mat4(1), glm::vec3(atomSizeFactor)));
+    for (Mesh& lod : Geometry::lods) lod.setModel(glm::scale(glm::mat4(1), glm::vec3(atomSizeFactor)));
+    Geometry::meshes.at("bond").setModel(glm::scale(glm::mat4(1), glm::vec3(bondSize, 1, bondSize)));
+    for (const Shader* program : { &shader, &sshader }) {
+        program->use(), program->set<glm::mat4>("u_transform", transform), program->set<float>("u_alpha", alpha), program->set<int>("u_resident", 0);
+    }
+}
+
+/*
+Sets the periodic cell of all frames, a zero cell removes it. The rebinding and the export are finished first, then the
+frames are bonded again with the minimum image distances. Streamed frames get the cell from the decoder.
+*/
+void Trajectory::setCell(const glm::mat3& cell) {
+    finish(), this->cell = cell, indexed = nullptr;
+    if (!cache) {
+        writer = std::jthread(); for (Geometry& geom : geoms) geom.setCell(cell);
+    }
+    rebind(factor);
+}
+
+/*
+Sets the atom size factor of all frames, it is applied when rendering.
+*/
+void Trajectory::setAtomSizeFactor(float factor) {
+    atomSizeFactor = factor;
+}
+
+/*
+Sets the bond thickness of all frames, it is applied when rendering.
+*/
+void Trajectory::setBondSize(float size) {
+    bondSize = size;
+}
+
@@ -0,0 +1,162 @@
+#include "writer.h"
+
+/*
+Start exporting the selected frames and atoms with the transform applied in the background. The path with the binary extension
+selects the binary format, otherwise the frames are written as .xyz text.
+*/
+Writer::Writer(const std::string& path, size_t frames, std::function<std::shared_ptr<const Geometry>(size_t)> frame, const glm::mat4& transform, const Selection& selection)
+    : frame(frame), atoms(selection.atoms), transform(transform), path(path), binary(path.ends_with(extension)) {
+    for (int i = std::max(selection.start, 0); i < std::min<long>(selection.end, frames); i += std::max(selection.stride, 1)) indices.push_back(i);
+    thread = std::jthread([this](std::stop_token stop) {
+        try { run(stop); } catch (...) { error = std::current_exception(); }
+        done = true;
+    });
+}
+
+Writer::~Writer() {
+    if (thread.joinable()) thread.request_stop(), thread.join();
+}
+
+/*
+Parse the start:end:stride frame range and the comma separated 1-based atom indices and index ranges like 1-10,15. Missing
+values select all frames and atoms. Throws for values that are not numbers and for reversed ranges.
+*/
+Writer::Selection Writer::Parse(std::string frames, std::string atoms) {
+    Selection selection; int* values[3] = { &selection.start, &selection.end, &selection.stride }; std::string range = frames;
+
+    // parse the frame range
+    for (int i = 0; i < 3 && !frames.empty(); i++) {
+        std::string value = frames.substr(0, frames.find(':')); frames.erase(0, value.size() + 1);
+        try { if (!value.empty()) *values[i] = std::stoi(value); } catch (const std::logic_error&) { throw std::runtime_error("Invalid frame range " + range + "."); }
+    }
+    if (selection.end < selection.start) throw std::runtime_error("Invalid frame range " + range + ".");
+
+    // parse the atom indices
+    while (!atoms.empty()) {
+        std::string value = atoms.substr(0, atoms.find(',')); atoms.erase(0, value.size() + 1);
+        if (value.empty()) continue;
+        size_t first = 0, last = 0;
+        try {
+            first = std::stoul(value), last = value.find('-') == std::string::npos ? first : std::stoul(value.substr(value.find('-') + 1));
+        } catch (const std::logic_error&) { throw std::runtime_error("Invalid atom range " + value + "."); }
+        if (first < 1 || last < first) throw std::runtime_error("Invalid atom range " + value + ".");
+        for (size_t j = first; j <= last; j++) selection.atoms.push_back(j - 1);
+    }
+
+    // return the selection
+    return selection;
+}
+
+/*
+Wait for the export to finish and rethrow its error.
+*/
+void Writer::wait() {
+    if (thread.joinable()) thread.join();
+    if (error) std::rethrow_exception(error);
+}
+
+/*
+Format the selected atoms of the frame. The text is formatted with std::to_chars into one buffer, the binary record is the
+array of positions.
+*/
+std::string Writer::format(const Geometry& geom) const {
+    size_t count = atoms.empty() ? geom.size() : atoms.size(); std::string buffer;
+
+    // function that returns the transformed position of the selected atom
+    auto position = [&](size_t i) {
+        size_t atom = atoms.empty() ? i : atoms.at(i);
+        if (atom >= geom.size()) throw std::runtime_error("Atom " + std::to_string(atom + 1) + " is not in the frame.");
+        return glm::vec3(transform * glm::vec4(geom.getPositions().at(atom), 1));
+    };
+
+    // copy the positions of the binary record
+    if (binary) {
+        buffer.resize(count * sizeof(glm::vec3));
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 value = position(i); std::memcpy(buffer.data() + i * sizeof(glm::vec3), &value, sizeof(glm::vec3));
+        }
+        return buffer;
+    }
+
+    // format the atom count, the comment with the rotated cell as the extended lattice and the atom lines
+    char number[32]; buffer.reserve(count * 48 + 128);
+    buffer.append(number, std::to_chars(number, number + sizeof(number), count).ptr).append("\n");
+    if (glm::mat3 cell = glm::mat3(transform) * geom.getCell(); geom.getCell() != glm::mat3(0)) {
+        buffer.append("Lattice=\"");
+        for (int i = 0; i < 9; i++) buffer.append(i ? " " : "").append(number, std::to_chars(number, number + sizeof(number), cell[i / 3][i % 3]).ptr);
+        buffer.append("\" ");
+    }
+    buffer.append("trajectory\n");
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 value = position(i); buffer.append(geom.getSymbol(atoms.empty() ? i : atoms.at(i)));
+        for (int j = 0; j < 3; j++) buffer.append(1, ' ').append(number, std::to_chars(number, number + sizeof(number), value[j]).ptr);
+        buffer.append(1, '\n');
+    }
+    return buffer;
+}
+
+/*
+Export the frames. The frames are formatted in parallel into a window of slots and written in order as soon as the next one
+is ready. The binary file starts with the header, the element symbols and the element ids of the selected atoms, all
+frames must then share the topology of the first one. A canceled or failed export removes the file.
+*/
+void Writer::run(std::stop_token stop) {
+    std::ofstream file(path, std::ios::binary); Profiler::Scope scope("Export");
+    if (!file) throw std::runtime_error("Could not open " + path + " for writing.");
+    std::shared_ptr<Topology> topology = indices.empty() ? nullptr : frame(indices.front())->getTopology();
+
+    // write the binary header, element symbols and ids
+    if (binary && topology) {
+        std::vector<std::string> symbols; std::vector<uint16_t> ids;
+        for (size_t i = 0; i < (atoms.empty() ? topology->size() : atoms.size()); i++) {
+            const std::string& symbol = topology->getSymbol(atoms.empty() ? i : atoms.at(i));
+            ids.push_back(std::find(symbols.begin(), symbols.end(), symbol) - symbols.begin());
+            if (ids.back() == symbols.size()) symbols.push_back(symbol);
+        }
+        Header header = { { 'L', 'X', 'Y', 'Z' }, version, indices.size(), ids.size(), symbols.size() };
+        file.write((const char*)&header, sizeof(Header));
+        for (const std::string& symbol : symbols) {
+            char name[4] = {}; symbol.copy(name, 4); file.write(name, 4);
+        }
+        file.write((const char*)ids.data(), ids.size() * sizeof(uint16_t)), file.write("\0\0\0", (4 - file.tellp() % 4) % 4);
+    }
+
+    // shared state of the pipeline, the slot of a frame is its position modulo the window
+    size_t nthread = std::max(2u, std::thread::hardware_concurrency()) - 1, window = 4 * nthread;
+    std::vector<std::string> slots(window); std::vector<size_t> ready(window, SIZE_MAX);
+    std::condition_variable_any condition; std::atomic<size_t> next = 0; std::exception_ptr failure; std::mutex mutex;
+
+    // format the frames on the worker threads, a frame waits until its slot is free
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < nthread; i++) threads.emplace_back([&]() {
+        for (size_t j = next++; j < indices.size(); j = next++) {
+            if (std::unique_lock<std::mutex> lock(mutex); !condition.wait(lock, stop, [&]() { return j < written + window || failure; }) || failure) return;
+            try {
+                std::shared_ptr<const Geometry> geom = frame(indices.at(j));
+                if (binary && geom->getTopology() != topology) throw std::runtime_error("The binary export needs frames with the same atoms.");
+                std::string buffer = format(*geom);
+                std::lock_guard<std::mutex> lock(mutex); slots.at(j % window) = std::move(buffer), ready.at(j % window) = j;
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex); failure = std::current_exception();
+            }
+            condition.notify_all();
+        }
+    });
+
+    // write the frames in order and free their slots
+    for (size_t j = 0; j < indices.size(); j++) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!condition.wait(lock, stop, [&]() { return ready.at(j % window) == j || failure; }) || failure) break;
+        std::string buffer = std::move(slots.at(j % window)); lock.unlock();
+        file.write(buffer.data(), buffer.size());
+        lock.lock(), written++, condition.notify_all();
+    }
+
+    // wait for the workers, remove the incomplete file and rethrow the error
+    for (std::thread& thread : threads) thread.join();
+    if (file.close(); failure || stop.stop_requested() || !file) {
+        std::error_code code; std::filesystem::remove(path, code);
+        if (failure) std::rethrow_exception(failure);
+        if (!stop.stop_requested()) throw std::runtime_error("Could not write " + path + ".");
+    }
+}